@@ -54,14 +54,16 @@ static void pvCaConnectionHandler(struct connection_handler_args args)
     var->conn_handler(args.op == CA_OP_CONN_UP, var->arg);
 }
 
-epicsShareFunc pvStat pvVarCreate(pvSystem sys, const char *name,
+epicsShareFunc pvStat pvVarCreate(pvSystem sys, const char *name, unsigned priority,
     pvConnFunc *conn_func, pvEventFunc *event_func, void *arg, pvVar *var)
 {
     assert(var);
     var->conn_handler = conn_func;
     var->event_handler = event_func;
     var->arg = arg;
-    INVOKE(var, ca_create_channel(name, pvCaConnectionHandler, var, CA_PRIORITY_DEFAULT, &var->chid));
+    if (priority > CA_PRIORITY_MAX)
+        priority = CA_PRIORITY_MAX;
+    INVOKE(var, ca_create_channel(name, pvCaConnectionHandler, var, priority, &var->chid));
     return pvStatOK;
 }
 
@@ -65,7 +65,7 @@ epicsShareFunc pvStat pvSysCreate(pvSystem *pSys);
 epicsShareFunc pvStat pvSysFlush(pvSystem sys);
 epicsShareFunc pvStat pvSysAttach(pvSystem sys);
 
-epicsShareFunc pvStat pvVarCreate(pvSystem sys, const char *name,
+epicsShareFunc pvStat pvVarCreate(pvSystem sys, const char *name, unsigned priority,
     pvConnFunc *conn_func, pvEventFunc *event_func, void *arg, pvVar *var);
 epicsShareFunc pvStat pvVarDestroy(pvVar *var);
 epicsShareFunc pvStat pvVarGetCallback(pvVar *var, pvType type, unsigned count, void *arg);
@@ -46,6 +46,7 @@ in the file LICENSE that is included with this distribution.
 #include "epicsMutex.h"
 #include "epicsString.h"
 #include "epicsThread.h"
+#include "epicsTimer.h"
 #include "epicsTime.h"
 #include "errlog.h"
 #include "freeList.h"
@@ -47,7 +47,8 @@ extern "C" {
 enum compType {
 	DEFAULT,
         ASYNC,
-        SYNC
+        SYNC,
+        CACHED          /* like SYNC, but use monitored value if available */
 };
 
 typedef	struct state_set *const SS_ID;	/* state set id, opaque */
@@ -88,8 +89,10 @@ epicsShareFunc seqBool seq_pvPutComplete(SS_ID, CH_ID,
 	unsigned, seqBool, seqBool*);
 epicsShareFunc void seq_pvGetCancel(SS_ID, CH_ID);
 epicsShareFunc void seq_pvPutCancel(SS_ID, CH_ID);
+epicsShareFunc unsigned seq_pvPutPending(SS_ID, CH_ID);
 epicsShareFunc pvStat seq_pvAssignSubst(SS_ID, CH_ID, const char *);
 epicsShareFunc pvStat seq_pvAssign(SS_ID, CH_ID, const char *);
+epicsShareFunc pvStat seq_pvArrayAssign(SS_ID, CH_ID, unsigned, string *);
 epicsShareFunc pvStat seq_pvMonitor(SS_ID, CH_ID);
 epicsShareFunc void seq_pvSync(SS_ID, CH_ID, EF_ID);
 epicsShareFunc pvStat seq_pvStopMonitor(SS_ID, CH_ID);
@@ -122,7 +125,9 @@ epicsShareFunc void epicsShareAPI seqShow(epicsThreadId);
 epicsShareFunc void epicsShareAPI seqChanShow(epicsThreadId, const char *);
 epicsShareFunc void epicsShareAPI seqcar(int level);
 epicsShareFunc void epicsShareAPI seqQueueShow(epicsThreadId);
+epicsShareFunc void epicsShareAPI seqProfileShow(const char *);
 epicsShareFunc void epicsShareAPI seqStop(epicsThreadId);
+epicsShareFunc void epicsShareAPI seqSetPvSystems(unsigned);
 epicsShareFunc epicsThreadId epicsShareAPI seq(seqProgram *, const char *, unsigned);
 
 /* backwards compatibility macros */
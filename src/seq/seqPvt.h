@@ -39,18 +39,40 @@ in the file LICENSE that is included with this distribution.
 
 #include "seq_queue.h"
 
-#define valPtr(ch,ss)		((char*)(ss)->var+(ch)->offset)
-#define bufPtr(ch)		((char*)(ch)->prog->var+(ch)->offset)
-
 #define ssNum(ss)		((ss)-(ss)->prog->ss)
 #define chNum(ch)		((ch)-(ch)->prog->chan)
 
-#define metaPtr(ch,ss) (			\
-	(ch)->dbch				\
-	?(optTest((ch)->prog,OPT_SAFE)		\
-		?(ss)->metaData + chNum(ch)	\
-		:&(ch)->dbch->metaData)		\
-	:0					\
+/* hot data of channel ch */
+#define chHot(ch)		((ch)->prog->chanHot+chNum(ch))
+
+#define valPtr(ch,ss)		((char*)(ss)->var+chHot(ch)->offset)
+#define bufPtr(ch)		((char*)(ch)->prog->var+chHot(ch)->offset)
+
+/* no request slot, see seq_ss_slot */
+#define NO_SLOT			((unsigned)-1)
+
+/* request slots for pending puts of slot number n (maxPuts of them) */
+#define putReqs(ss,n)		((ss)->putReq+(n)*(ss)->prog->maxPuts)
+
+/* upper limit for the maxputs program parameter */
+#define MAX_PUTS		256
+
+/* all channels connected & got 1st monitor (except for lazy ones) */
+#define allConnected(sp) (						\
+	(sp)->connectCount + (sp)->lazyCount == (sp)->assignCount	\
+	&& (sp)->gotMonitorCount == (sp)->monitorCount			\
+)
+
+/* whether a state with the given event mask waits for channel ch */
+#define waitsFor(mask,ch) (						\
+	bitTest(mask,chHot(ch)->eventNum)				\
+	|| ((ch)->syncedTo && bitTest(mask,(ch)->syncedTo))		\
+)
+
+/* whether channel ch should currently be monitored */
+#define wantMonitor(ch) (						\
+	(ch)->monitored							\
+	&& (!(ch)->autoMon || (ch)->autoMonUsers || (ch)->autoMonOff)	\
 )
 
 #define optTest(sp,opt)		(((sp)->options & (opt)) != 0)
@@ -83,29 +105,63 @@ typedef struct program_instance	PROG;
 typedef struct pvreq		PVREQ;
 typedef const struct pv_type	PVTYPE;
 typedef struct pv_meta_data	PVMETA;
+typedef struct chan_hot		CHANHOT;
+typedef struct snapshot		SNAPSHOT;
 
 typedef struct seqg_vars        SEQ_VARS;
 
+/* Channel data used when copying values and waking up state sets;
+   kept in an array parallel to the channel array, see chHot */
+struct chan_hot
+{
+	size_t		offset;		/* offset to value (e.g. in prog->var) */
+	size_t		size;		/* number of bytes to copy (for db
+					   channels only dbCount elements) */
+	unsigned	eventNum;	/* event number */
+};
+
 /* Channel, i.e. an assigned variable */
 struct channel
 {
 	/* static channel data (assigned once on startup) */
-	size_t		offset;		/* offset to value (e.g. in prog->var) */
 	const char	*varName;	/* variable name */
 	unsigned	count;		/* number of elements in array */
-	unsigned	eventNum;	/* event number */
 	PVTYPE		*type;		/* request type info */
 	PROG		*prog;		/* state program that owns this struct*/
+	unsigned	priority;	/* CA priority */
 
 	/* dynamic channel data (assigned at runtime) */
 	DBCHAN		*dbch;		/* channel assigned to a named db pv */
 	EF_ID		syncedTo;	/* event flag id if synced */
 	CHAN		*nextSynced;	/* next channel synced to same flag */
+	CHAN		*nextShared;	/* next channel sharing the same pv */
 	QUEUE		queue;		/* queue if queued */
+	boolean		singlePutter;	/* only one state set puts to the
+					   (anonymous) queue, see anonymous_put */
 	boolean		monitored;	/* whether channel is monitored */
+	/* automatic monitors (OPT_AUTOMON), protected by prog->lock */
+	boolean		autoMon;	/* monitor follows the current states */
+	unsigned	autoMonUsers;	/* state sets in a state waiting for it */
+	double		autoMonOff;	/* when to turn monitor off (0 = never) */
 	/* buffer access, only used in safe mode */
 	epicsMutexId	varLock;	/* mutex for locking access to shared
 					   var buffer and meta data */
+	SNAPSHOT	*snapshot;	/* shared value if large, see seq_task.c */
+	SNAPSHOT	*spare;		/* unused snapshot, for the next write */
+	unsigned	writeSeq;	/* number of the last started write */
+	unsigned	publishSeq;	/* number of the published write */
+};
+
+/* Reference counted copy of a large channel value (safe mode) */
+struct snapshot
+{
+	unsigned	refCount;	/* references, protected by varLock */
+	size_t		size;		/* number of valid bytes */
+	unsigned	version;	/* assigned when published, never 0 */
+	unsigned	numBlocks;	/* number of SNAPSHOT_BLOCK_SIZE blocks */
+	unsigned	*blockVersion;	/* for each block the version that
+					   last changed it (+k) */
+	double		value[1];	/* the value (actually larger) */
 };
 
 struct pv_type
@@ -125,14 +181,46 @@ struct pv_meta_data
 	const char	*message;	/* error message */
 };
 
+/* Copy a channel value of size bytes and return dest. Values of the
+   usual scalar sizes are copied with a constant size, which compilers
+   turn into a single load and store instead of a call to memcpy.
+   Note: size is evaluated more than once. */
+#define copyValue(dest,src,size) (			\
+	(size) == 8 ? memcpy(dest,src,8) :		\
+	(size) == 4 ? memcpy(dest,src,4) :		\
+	(size) == 2 ? memcpy(dest,src,2) :		\
+	(size) == 1 ? memcpy(dest,src,1) :		\
+	memcpy(dest,src,size)				\
+)
+
+/* Per state set hot data is aligned to this, see layout_prog */
+#define CACHE_LINE_SIZE		64
+
+/* In safe mode, values of channels at least this large are shared as
+   snapshots instead of in the shared variable block, see seq_task.c */
+#define SNAPSHOT_MIN_SIZE	4096
+/* With option +k, snapshots track changes in blocks of this size */
+#define SNAPSHOT_BLOCK_SIZE	1024
+
+/* Names up to this size are stored inside the db channel */
+#define DBCHAN_NAME_SIZE	64
+
 /* Channel assigned to a named (database) pv */
 struct db_channel
 {
 	char		*dbName;	/* channel name after macro expansion */
-	pvVar		pvid;		/* PV (process variable) id */
+	char		nameBuf[DBCHAN_NAME_SIZE];/* holds dbName if short enough */
+	pvVar		*pvid;		/* PV (process variable) id, shared
+					   with other channels, see seq_share.c */
 	unsigned	dbCount;	/* actual count for db access */
 	boolean		connected;	/* whether channel is connected */
 	boolean		gotMonitor;	/* whether we got a monitor after connect */
+	boolean		subscribed;	/* whether we take part in the monitor */
+	boolean		wantValue;	/* waiting for the current value of a
+					   shared monitor, see seq_share.c */
+	boolean		lazy;		/* not yet connected, see OPT_LAZY */
+	SSCB		*connWaiter;	/* state set waiting in pvGet/pvPut for
+					   the lazy connection, or NULL */
 	PVMETA		metaData;	/* meta data (shared buffer) */
 };
 
@@ -143,6 +231,7 @@ struct state_set
 	/* static state set data (assigned once on startup) */
 	const char	*ssName;	/* state set name (for debugging) */
 	epicsThreadId	threadId;	/* thread id */
+	SSCB		*nextByThread;	/* next in thread id index, see seq_prog.c */
 	unsigned	numStates;	/* number of states */
 	STATE		*states;	/* ptr to array of state blocks */
 	PROG		*prog;		/* ptr back to state program block */
@@ -152,16 +241,34 @@ struct state_set
 	int		nextState;	/* next state index, -1 if none */
 	int		prevState;	/* previous state index, -1 if none */
 	const bitMask	*mask;		/* current event mask */
+	bitMask		*waitMask;	/* events any state waits for */
 	double		timeEntered;	/* time that current state was entered */
 	double		wakeupTime;	/* next time state set should wake up */
 	epicsEventId	syncSem;	/* semaphore for event sync */
 	epicsEventId	dead;		/* event to signal state set exit done */
-	/* these are arrays, one for each channel */
+	/* channels used by this state set, see seq_ss_slot */
+	const unsigned	*slotChan;	/* sorted channel numbers, one for each
+					   slot, NULL if every channel has one */
+	unsigned	numSlots;	/* number of slots */
+	const bitMask	*readMask;	/* channels this state set reads (safe
+					   mode), NULL if it might read any */
+	/* these are arrays, one for each slot */
 	PVREQ		**getReq;	/* currently pending get requests */
-	PVREQ		**putReq;	/* currently pending put requests */
+	PVREQ		**putReq;	/* currently pending put requests
+					   (maxPuts per slot) */
 	PVMETA		*metaData;	/* meta data (safe mode) */
 	/* safe mode */
-	boolean		*dirty;		/* array of flags, one for each channel */
+	boolean		*dirty;		/* array of flags, one for each slot */
+	unsigned	*seen;		/* snapshot version of local copy, one
+					   for each slot (+k), 0 if none */
+	/* combined puts (+b) */
+	char		**putBuf;	/* staged put value, one for each channel */
+	boolean		*staged;	/* whether a put is staged, per channel */
+	unsigned	*stagedChans;	/* channel numbers of staged puts */
+	unsigned	numStaged;	/* number of staged puts */
+	unsigned	combinedPuts;	/* number of puts combined with a later one */
+	/* automatic monitors (+u) */
+	double		autoMonNext;	/* next time to turn monitors off (0 = none) */
 };
 
 STATIC_ASSERT(offsetof(struct state_set,var)==0);
@@ -177,36 +284,57 @@ struct program_instance
 	unsigned	stackSize;	/* stack size (all threads) */
 	pvSystem	pvSys;		/* pv system handle */
 	CHAN		*chan;		/* table of channels */
+	CHANHOT		*chanHot;	/* hot channel data, parallel to chan */
 	unsigned	numChans;	/* number of channels */
 	QUEUE		*queues;	/* array of syncQ queues */
 	unsigned	numQueues;	/* number of syncQ queues */
 	SSCB		*ss;		/* array of state set control blocks */
 	unsigned	numSS;		/* number of state sets */
 	size_t		varSize;	/* size of user variable area */
-	MACRO		*macros;	/* ptr to macro table */
+	MACRO		**macros;	/* macro hash table */
+	MACRO		**macroCache;	/* hash table of expanded strings */
+	unsigned	numCached;	/* number of entries in macroCache */
 	char		*params;	/* program parameters */
 	unsigned	options;	/* options (bit-encoded) */
 	SEQ_PROG_FUNC	*initFunc;	/* init function */
 	SEQ_SS_FUNC	*entryFunc;	/* entry function */
 	SEQ_SS_FUNC	*exitFunc;	/* exit function */
 	unsigned	numEvFlags;	/* number of event flags */
+	unsigned	maxPuts;	/* max. pending puts per channel & ss */
+	unsigned	caPriority;	/* CA priority for channels without one */
+	double		monGrace;	/* delay before an automatic monitor
+					   is turned off */
 
 	/* dynamic program data (assigned at runtime) */
 	epicsMutexId	lock;	/* mutex for locking dynamic program data */
-	/* the following five members must always be protected by lock */
+	/* the following members must always be protected by lock */
 	bitMask		*evFlags;	/* event bits for event flags & channels */
 	CHAN		**syncedChans;	/* for each event flag, start of synced list */
 	unsigned	assignCount;	/* number of channels assigned to ext. pv */
+	unsigned	lazyCount;	/* number of those not yet connected
+					   because of OPT_LAZY */
 	unsigned	connectCount;	/* number of channels connected */
 	unsigned	monitorCount;	/* number of channels monitored */
 	unsigned	gotMonitorCount;/* number of monitored channels that got
 					   a monitor event */
+	unsigned	cachedGetCount;	/* number of sync. gets satisfied from
+					   the monitor cache */
+	double		connStart;	/* time when connecting started */
+	double		connRamp[3];	/* time to 50%, 90%, 100% connected */
+	unsigned	connRampSteps;	/* number of connRamp entries reached */
+	boolean		connWakeupPending;/* connection wakeup timer running */
+	double		lastConnWakeup;	/* time of last connection wakeup */
 
 	void		*pvReqPool;	/* freeList for pv requests (has own lock) */
+	void		*dbchPool;	/* freeList for db channels (has own lock) */
+	epicsTimerQueueId timerQueue;	/* for connWakeupTimer */
+	epicsTimerId	connWakeupTimer;/* delivers batched connection wakeups */
 	boolean		die;		/* flag set when seqStop is called */
 	epicsEventId	ready;		/* all channels connected & got 1st monitor */
 	epicsEventId	dead;		/* event to signal exit of main thread done */
 	PROG		*next;		/* next element in program list */
+	void		*arena;		/* memory block holding this struct and
+					   its arrays, see layout_prog */
 };
 
 STATIC_ASSERT(offsetof(struct program_instance,var)==0);
@@ -223,19 +351,27 @@ struct pvreq
 #define THREAD_STACK_SIZE	epicsThreadStackBig
 #define THREAD_PRIORITY		epicsThreadPriorityMedium
 
+/* State sets are woken up at most once per this many seconds for
+   connection changes */
+#define CONN_WAKEUP_WINDOW	0.05
+
 /* Internal procedures */
 
 /* seq_task.c */
 void sequencer(void *arg);
-void ss_write_buffer(CHAN *ch, void *val, PVMETA *meta, boolean dirtify);
+void ss_write_buffer(SSCB *writer, CHAN *ch, void *val, PVMETA *meta,
+	boolean dirtify);
+void ss_free_snapshots(PROG *sp);
 void ss_read_buffer(SSCB *ss, CHAN *ch, boolean dirty_only);
 void ss_read_buffer_selective(PROG *sp, SSCB *ss, EF_ID ev_flag);
 void ss_wakeup(PROG *sp, unsigned eventNum);
+unsigned seq_ss_slot(SSCB *ss, unsigned nch);
+PVMETA *seq_ss_meta(SSCB *ss, CHAN *ch);
 
 /* seq_mac.c */
 void seqMacParse(PROG *sp, const char *macStr);
 char *seqMacValGet(PROG *sp, const char *name);
-void seqMacEval(PROG *sp, const char *inStr, char *outStr, size_t maxChar);
+const char *seqMacEval(PROG *sp, const char *inStr, boolean cache, char **tmp);
 void seqMacFree(PROG *sp);
 
 /* seq_ca.c */
@@ -243,7 +379,22 @@ pvConnFunc seq_conn_handler;
 pvEventFunc seq_event_handler;
 pvStat seq_connect(PROG *sp, boolean wait);
 void seq_disconnect(PROG *sp);
+boolean seq_connect_lazy(CHAN *ch);
+void seq_connect_lazy_mask(PROG *sp, const bitMask *mask);
 pvStat seq_camonitor(CHAN *ch, boolean on);
+DBCHAN *seq_dbch_new(PROG *sp, const char *name);
+boolean seq_dbch_set_name(DBCHAN *dbch, const char *name);
+void seq_dbch_free(PROG *sp, DBCHAN *dbch);
+void seq_chan_set_size(CHAN *ch);
+
+/* seq_share.c */
+pvStat seqShareCreate(CHAN *ch);
+pvStat seqShareDestroy(CHAN *ch, DBCHAN *dbch);
+pvStat seqShareMonitor(CHAN *ch, boolean on);
+unsigned seqShareCount(CHAN *ch);
+
+/* seq_if.c */
+void ss_flush_puts(SSCB *ss);
 
 /* seq_prog.c */
 typedef int seqTraversee(PROG *prog, void *param);
@@ -252,11 +403,16 @@ SSCB *seqFindStateSet(epicsThreadId threadId);
 PROG *seqFindProg(epicsThreadId threadId);
 void seqDelProg(PROG *sp);
 void seqAddProg(PROG *sp);
+void seqAddStateSet(SSCB *ss);
 
 /* seqCommands.c */
 typedef int sequencerProgramTraversee(PROG **prog, seqProgram *pseq, void *param);
 int traverseSequencerPrograms(sequencerProgramTraversee *traversee, void *param);
+int visitSequencerProgram(const char *progName,
+	sequencerProgramTraversee *traversee, void *param);
 void createOrAttachPvSystem(PROG *sp);
+typedef int seqProfileTraversee(seqProfile *profile, void *param);
+int traverseProfiles(seqProfileTraversee *traversee, void *param);
 
 /* seq_main.c */
 void seq_free(PROG *sp);
@@ -38,9 +38,14 @@ static void proc_db_events(
 	pvType		type,	/* type of value */
 	CHAN		*ch,	/* channel object */
 	SSCB		*ss,	/* originator, for put and get, else 0 */
+	PVREQ		**req,	/* request slot, for put and get, else 0 */
 	pvEventType	evtype,	/* put, get, or monitor */
 	pvStat		status	/* status from pv layer */
 );
+static boolean conn_progress(PROG *sp);
+static void conn_report(PROG *sp);
+static void conn_wakeup(PROG *sp);
+static void conn_wakeup_expire(void *arg);
 
 /*
  * seq_connect() - Initiate connect & monitor requests to PVs.
@@ -53,6 +58,20 @@ pvStat seq_connect(PROG *sp, boolean wait)
 	int		delay = 2;
 	boolean		ready = FALSE;
 
+	pvTimeGetCurrentDouble(&sp->connStart);
+
+	/* Timer for batched wakeups on connection changes */
+	sp->timerQueue = epicsTimerQueueAllocate(TRUE, sp->threadPriority);
+	if (sp->timerQueue)
+		sp->connWakeupTimer = epicsTimerQueueCreateTimer(
+			sp->timerQueue, conn_wakeup_expire, sp);
+	if (!sp->connWakeupTimer)
+	{
+		errlogSevPrintf(errlogFatal, "seq_connect: "
+			"failed to create timer\n");
+		return pvStatERROR;
+	}
+
 	/*
 	 * For each channel: create pv object, then subscribe if monitored.
 	 */
@@ -63,27 +82,29 @@ pvStat seq_connect(PROG *sp, boolean wait)
 
 		if (dbch == NULL)
 			continue; /* skip records without pv names */
+		if (dbch->lazy)
+			continue; /* connect on first use */
 		DEBUG("seq_connect: connect %s to %s\n", ch->varName,
 			dbch->dbName);
-		/* Connect to it */
-		status = pvVarCreate(
-				sp->pvSys,		/* PV system context */
-				ch->dbch->dbName,	/* PV name */
-				seq_conn_handler,	/* connection handler routine */
-				seq_event_handler,	/* event handler routine */
-				ch,			/* private data is CHAN struc */
-				&dbch->pvid);		/* ptr to PV id */
+		/* Connect to it (or share an existing connection) */
+		status = seqShareCreate(ch);
 		if (status != pvStatOK)
 		{
-			errlogSevPrintf(errlogFatal, "seq_connect(var '%s', pv '%s'): pvVarCreate() failure: "
-				"%s\n", ch->varName, dbch->dbName, pvVarGetMess(dbch->pvid));
-			free(ch->dbch->dbName);
-			free(ch->dbch);
+			seq_dbch_free(sp, ch->dbch);
+			ch->dbch = NULL;
+			seq_chan_set_size(ch);
 			continue;
 		}
 	}
 	pvSysFlush(sp->pvSys);
 
+	/* In case there is nothing to wait for */
+	epicsMutexMustLock(sp->lock);
+	ready = conn_progress(sp);
+	epicsMutexUnlock(sp->lock);
+	if (ready)
+		conn_report(sp);
+
 	if (wait)
 	{
 		boolean firstTime = TRUE;
@@ -98,7 +119,7 @@ pvStat seq_connect(PROG *sp, boolean wait)
 				return pvStatERROR;
 
 			epicsMutexMustLock(sp->lock);
-			ac = sp->assignCount;
+			ac = sp->assignCount - sp->lazyCount;
 			mc = sp->monitorCount;
 			cc = sp->connectCount;
 			gmc = sp->gotMonitorCount;
@@ -149,11 +170,16 @@ static void seq_get_handler(
 	CHAN	*ch = rq->ch;
 	SSCB	*ss = rq->ss;
 	PROG	*sp = ch->prog;
+	unsigned slot = seq_ss_slot(ss, chNum(ch));
 
 	freeListFree(sp->pvReqPool, arg);
-	/* ignore callback if not expected, e.g. already timed out */
-	if (ss->getReq[chNum(ch)] == rq)
-		proc_db_events(value, type, ch, ss, pvEventGet, status);
+	/* ignore callback if not expected, e.g. already timed out or
+	   cancelled by pvAssign (which holds the lock while doing so) */
+	epicsMutexMustLock(sp->lock);
+	if (slot != NO_SLOT && ss->getReq[slot] == rq)
+		proc_db_events(value, type, ch, ss, ss->getReq + slot,
+			pvEventGet, status);
+	epicsMutexUnlock(sp->lock);
 }
 
 /*
@@ -167,11 +193,27 @@ static void seq_put_handler(
 	CHAN	*ch = rq->ch;
 	SSCB	*ss = rq->ss;
 	PROG	*sp = ch->prog;
+	unsigned slot = seq_ss_slot(ss, chNum(ch));
+	PVREQ	**putReq;
+	unsigned n;
 
 	freeListFree(sp->pvReqPool, arg);
-	/* ignore callback if not expected, e.g. already timed out */
-	if (ss->putReq[chNum(ch)] == rq)
-		proc_db_events(value, type, ch, ss, pvEventPut, status);
+	if (slot == NO_SLOT)
+		return;
+	putReq = putReqs(ss,slot);
+	/* ignore callback if not expected, e.g. already timed out or
+	   cancelled by pvAssign (which holds the lock while doing so) */
+	epicsMutexMustLock(sp->lock);
+	for (n = 0; n < sp->maxPuts; n++)
+	{
+		if (putReq[n] == rq)
+		{
+			proc_db_events(value, type, ch, ss, putReq + n,
+				pvEventPut, status);
+			break;
+		}
+	}
+	epicsMutexUnlock(sp->lock);
 }
 
 /*
@@ -182,20 +224,19 @@ static void seq_mon_handler(
 {
 	CHAN	*ch = (CHAN *)arg;
 	PROG	*sp = ch->prog;
+	boolean	ready = FALSE;
 
-	proc_db_events(value, type, ch, 0, pvEventMonitor, status);
+	proc_db_events(value, type, ch, 0, 0, pvEventMonitor, status);
 	epicsMutexMustLock(sp->lock);
 	if (ch->dbch && !ch->dbch->gotMonitor)
 	{
 		ch->dbch->gotMonitor = TRUE;
 		sp->gotMonitorCount++;
-		if (sp->gotMonitorCount == sp->monitorCount
-			&& sp->connectCount == sp->assignCount)
-		{
-			epicsEventSignal(sp->ready);
-		}
+		ready = conn_progress(sp);
 	}
 	epicsMutexUnlock(sp->lock);
+	if (ready)
+		conn_report(sp);
 }
 
 /*
@@ -238,6 +279,7 @@ static void proc_db_events(
 	pvType		type,
 	CHAN		*ch,
 	SSCB		*ss,
+	PVREQ		**req,
 	pvEventType	evtype,
 	pvStat		status
 )
@@ -293,25 +335,25 @@ static void proc_db_events(
 		/* Set error message only when severity indicates error */
 		if (meta.severity != pvSevrNONE)
 		{
-			const char *pmsg = pvVarGetMess(ch->dbch->pvid);
+			const char *pmsg = pvVarGetMess(*ch->dbch->pvid);
 			if (!pmsg) pmsg = "unknown";
 			meta.message = pmsg;
 		}
 
 		/* Write value and meta data to shared buffers.
 		   Set the dirty flag only if this was a monitor event. */
-		ss_write_buffer(ch, val, &meta, evtype == pvEventMonitor);
+		ss_write_buffer(NULL, ch, val, &meta, evtype == pvEventMonitor);
 	}
 
 	/* Signal completion */
 	switch (evtype)
 	{
 	case pvEventPut:
-		ss->putReq[chNum(ch)] = NULL;
+		*req = NULL;
 		epicsEventSignal(ss->syncSem);
 		break;
 	case pvEventGet:
-		ss->getReq[chNum(ch)] = NULL;
+		*req = NULL;
 		epicsEventSignal(ss->syncSem);
 		if (optTest(sp, OPT_SAFE))
 			break;
@@ -320,7 +362,7 @@ static void proc_db_events(
 		/* Wake up each state set that uses this channel in a when condition. */
 		/* In safe mode this is only necessary for monitor events, since the
 		   effects of get events are local to the state set. */
-		ss_wakeup(sp, ch->eventNum);
+		ss_wakeup(sp, chHot(ch)->eventNum);
 		break;
 	}
 
@@ -331,6 +373,68 @@ static void proc_db_events(
 	epicsMutexUnlock(sp->lock);
 }
 
+/*
+ * seq_connect_lazy() - Connect a channel that was not connected at
+ * startup because of option +z. Returns TRUE if this call created the
+ * channel. The caller is responsible for flushing the request.
+ */
+boolean seq_connect_lazy(CHAN *ch)
+{
+	PROG	*sp = ch->prog;
+	DBCHAN	*dbch;
+	boolean	lazy;
+
+	epicsMutexMustLock(sp->lock);
+	dbch = ch->dbch;
+	lazy = dbch && dbch->lazy;
+	if (lazy)
+	{
+		dbch->lazy = FALSE;
+		sp->lazyCount--;
+		if (ch->monitored)
+			sp->monitorCount++;
+	}
+	epicsMutexUnlock(sp->lock);
+
+	if (!lazy)
+		return FALSE;
+
+	DEBUG("seq_connect_lazy: connect %s to %s\n", ch->varName,
+		dbch->dbName);
+	/* Monitor (if any) is turned on by the connection handler */
+	if (seqShareCreate(ch) != pvStatOK)
+	{
+		epicsMutexMustLock(sp->lock);
+		sp->assignCount--;
+		if (ch->monitored)
+			sp->monitorCount--;
+		ch->dbch = NULL;
+		seq_dbch_free(sp, dbch);
+		seq_chan_set_size(ch);
+		epicsMutexUnlock(sp->lock);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * seq_connect_lazy_mask() - Connect all lazy channels whose event
+ * bits are set in the given mask, i.e. that a state waits for.
+ */
+void seq_connect_lazy_mask(PROG *sp, const bitMask *mask)
+{
+	unsigned nch;
+
+	for (nch = 0; nch < sp->numChans; nch++)
+	{
+		CHAN	*ch = sp->chan + nch;
+		DBCHAN	*dbch = ch->dbch;
+
+		if (dbch && dbch->lazy && bitTest(mask, chHot(ch)->eventNum))
+			seq_connect_lazy(ch);
+	}
+}
+
 /* Disconnect all database channels */
 void seq_disconnect(PROG *sp)
 {
@@ -342,26 +446,30 @@ void seq_disconnect(PROG *sp)
 	for (nch = 0; nch < sp->numChans; nch++)
 	{
 		CHAN	*ch = sp->chan + nch;
-		pvStat	status;
 		DBCHAN	*dbch = ch->dbch;
 
-		if (!dbch)
+		if (!dbch || dbch->lazy)
 			continue;
 		DEBUG("seq_disconnect: disconnect %s from %s\n",
 			ch->varName, dbch->dbName);
 		/* Disconnect this PV */
 		epicsMutexUnlock(sp->lock);
-		/* Note: must unlock around pvVarDestroy to avoid deadlock
+		/* Note: must unlock around seqShareDestroy to avoid deadlock
 		   with pending callbacks. */
-		status = pvVarDestroy(&dbch->pvid);
+		seqShareDestroy(ch, dbch);
 		epicsMutexMustLock(sp->lock);
-		if (status != pvStatOK)
-			errlogSevPrintf(errlogFatal, "seq_disconnect(var '%s', pv '%s'): pvVarDestroy() failure: "
-				"%s\n", ch->varName, dbch->dbName, pvVarGetMess(dbch->pvid));
 	}
 	epicsMutexUnlock(sp->lock);
 
 	pvSysFlush(sp->pvSys);
+
+	/* No more connection events, so no more delayed wakeups */
+	if (sp->connWakeupTimer)
+		epicsTimerQueueDestroyTimer(sp->timerQueue, sp->connWakeupTimer);
+	if (sp->timerQueue)
+		epicsTimerQueueRelease(sp->timerQueue);
+	sp->connWakeupTimer = NULL;
+	sp->timerQueue = NULL;
 }
 
 pvStat seq_camonitor(CHAN *ch, boolean turn_on)
@@ -376,32 +484,25 @@ pvStat seq_camonitor(CHAN *ch, boolean turn_on)
 	epicsMutexMustLock(sp->lock);
 	dbch = ch->dbch;
 	assert(dbch);
-	done = turn_on == pvMonIsDefined(dbch->pvid);
-	dbch->gotMonitor = FALSE;
+	done = turn_on == dbch->subscribed;
+	if (!done)
+	{
+		/* Monitors may now be switched on and off repeatedly (+u),
+		   so only count what we actually got. */
+		if (dbch->gotMonitor)
+			sp->gotMonitorCount--;
+		dbch->gotMonitor = FALSE;
+	}
 	epicsMutexUnlock(sp->lock);
 
 	if (done)
 		return pvStatOK;
 
-	DEBUG("calling pvVarMonitor%s(%p)\n", turn_on ? "On" : "Off", ch);
-	if (turn_on)
-	{
-		status = pvVarMonitorOn(
-				&dbch->pvid,		/* pvid */
-				ch->type->getType,	/* requested type */
-				ch->count,		/* element count */
-				ch);			/* user arg (channel struct) */
-	}
-	else
-	{
-		status = pvVarMonitorOff(&dbch->pvid);
-		epicsMutexMustLock(sp->lock);
-		sp->gotMonitorCount -= 1;
-		epicsMutexUnlock(sp->lock);
-	}
+	DEBUG("calling seqShareMonitor(%p,%s)\n", ch, turn_on ? "on" : "off");
+	status = seqShareMonitor(ch, turn_on);
 	if (status != pvStatOK)
 		errlogSevPrintf(errlogFatal, "seq_camonitor: pvVarMonitor%s(var '%s', pv '%s') failure: %s\n",
-			turn_on?"On":"Off", ch->varName, dbch->dbName, pvVarGetMess(dbch->pvid));
+			turn_on?"On":"Off", ch->varName, dbch->dbName, pvVarGetMess(*dbch->pvid));
 	return status;
 }
 
@@ -414,6 +515,9 @@ void seq_conn_handler(int connected, void *arg)
 	CHAN	*ch = (CHAN *)arg;
 	PROG	*sp = ch->prog;
 	DBCHAN	*dbch = ch->dbch;
+	boolean	monitor = FALSE;	/* whether to switch monitor on/off */
+	boolean	ready = FALSE;
+	SSCB	*waiter = NULL;	/* state set waiting in connect_lazy */
 
 	epicsMutexMustLock(sp->lock);
 
@@ -433,18 +537,20 @@ void seq_conn_handler(int connected, void *arg)
 			dbch->connected = FALSE;
 			sp->connectCount--;
 
-			if (ch->monitored)
-			{
-				seq_camonitor(ch, FALSE);
-			}
+			monitor = ch->monitored;
 			/* terminate outstanding requests that wait for completion */
 			/* TODO: can there be a race condition with pvPut/pvGet? */
 			for (nss = 0; nss < sp->numSS; nss++)
 			{
 				SSCB *ss = sp->ss + nss;
-
-				ss->getReq[chNum(ch)] = NULL;
-				ss->putReq[chNum(ch)] = NULL;
+				unsigned slot = seq_ss_slot(ss, chNum(ch));
+				unsigned n;
+
+				if (slot == NO_SLOT)
+					continue;
+				ss->getReq[slot] = NULL;
+				for (n = 0; n < sp->maxPuts; n++)
+					putReqs(ss,slot)[n] = NULL;
 				epicsEventSignal(ss->syncSem);
 			}
 		}
@@ -464,20 +570,15 @@ void seq_conn_handler(int connected, void *arg)
 			unsigned dbCount;
 			dbch->connected = TRUE;
 			sp->connectCount++;
-			if (sp->gotMonitorCount == sp->monitorCount
-				&& sp->connectCount == sp->assignCount)
-			{
-				epicsEventSignal(sp->ready);
-			}
-			assert(pvVarIsDefined(dbch->pvid));
-			dbCount = pvVarGetCount(&dbch->pvid);
+			waiter = dbch->connWaiter;
+			ready = conn_progress(sp);
+			assert(pvVarIsDefined(*dbch->pvid));
+			dbCount = pvVarGetCount(dbch->pvid);
 			assert(dbCount >= 0);
 			dbch->dbCount = min(ch->count, (unsigned)dbCount);
+			seq_chan_set_size(ch);
 
-			if (ch->monitored)
-			{
-				seq_camonitor(ch, TRUE);
-			}
+			monitor = wantMonitor(ch);
 		}
 		else
 		{
@@ -489,10 +590,181 @@ void seq_conn_handler(int connected, void *arg)
 	}
 	epicsMutexUnlock(sp->lock);
 
+	if (ready)
+		conn_report(sp);
+
+	/* A state set waiting for a lazy connection must not wait for the
+	   (possibly delayed) wakeup of all state sets */
+	if (waiter)
+		epicsEventSignal(waiter->syncSem);
+
+	/* Must not hold the program lock here, see seq_share.c */
+	if (monitor)
+		seq_camonitor(ch, connected);
+
 	/* Wake up each state set that is waiting for event processing.
 	   Why each one? Because pvConnectCount and pvMonitorCount should
 	   act like monitored anonymous channels. Any state set might be
 	   using these functions inside a when-condition and it is expected
 	   that such conditions get checked whenever these counts change. */
+	conn_wakeup(sp);
+}
+
+/* Connection ramp steps in percent, see conn_progress */
+#define CONN_RAMP_STEPS 3
+static const unsigned conn_ramp_percent[CONN_RAMP_STEPS] = {50, 90, 100};
+
+/*
+ * conn_progress() - Called with the program lock held after a channel
+ * got connected or received its first monitor. Records the ramp timing
+ * and signals readiness. Returns TRUE if the ramp just got completed.
+ */
+static boolean conn_progress(PROG *sp)
+{
+	unsigned total = sp->assignCount - sp->lazyCount + sp->monitorCount;
+	unsigned done = sp->connectCount + sp->gotMonitorCount;
+	boolean	completed = FALSE;
+
+	while (sp->connRampSteps < CONN_RAMP_STEPS
+		&& done * 100 >= total * conn_ramp_percent[sp->connRampSteps])
+	{
+		double now;
+
+		pvTimeGetCurrentDouble(&now);
+		sp->connRamp[sp->connRampSteps++] = now - sp->connStart;
+		completed = sp->connRampSteps == CONN_RAMP_STEPS;
+	}
+	if (allConnected(sp))
+		epicsEventSignal(sp->ready);
+	return completed && total > 0;
+}
+
+/*
+ * conn_report() - Report connection ramp timing.
+ */
+static void conn_report(PROG *sp)
+{
+	errlogSevPrintf(errlogInfo,
+		"%s[%d]: connected 50%% after %.3f s, 90%% after %.3f s, "
+		"100%% after %.3f s\n", sp->progName, sp->instance,
+		sp->connRamp[0], sp->connRamp[1], sp->connRamp[2]);
+}
+
+/*
+ * conn_wakeup() - Wake up all state sets because of a connection change.
+ * At most one wakeup per CONN_WAKEUP_WINDOW is delivered immediately;
+ * further ones are combined into a single delayed wakeup. A state set
+ * waiting for a lazy connection is signalled directly by the connection
+ * handler instead.
+ */
+static void conn_wakeup(PROG *sp)
+{
+	boolean	wakeup = FALSE;
+	double	now;
+
+	pvTimeGetCurrentDouble(&now);
+	epicsMutexMustLock(sp->lock);
+	if (!sp->connWakeupPending)
+	{
+		if (now - sp->lastConnWakeup >= CONN_WAKEUP_WINDOW
+			|| !sp->connWakeupTimer)
+		{
+			sp->lastConnWakeup = now;
+			wakeup = TRUE;
+		}
+		else
+		{
+			sp->connWakeupPending = TRUE;
+			epicsTimerStartDelay(sp->connWakeupTimer,
+				sp->lastConnWakeup + CONN_WAKEUP_WINDOW - now);
+		}
+	}
+	epicsMutexUnlock(sp->lock);
+	if (wakeup)
+		ss_wakeup(sp, 0);
+}
+
+/*
+ * conn_wakeup_expire() - Timer callback, delivers a delayed wakeup.
+ */
+static void conn_wakeup_expire(void *arg)
+{
+	PROG	*sp = (PROG *)arg;
+
+	epicsMutexMustLock(sp->lock);
+	sp->connWakeupPending = FALSE;
+	pvTimeGetCurrentDouble(&sp->lastConnWakeup);
+	epicsMutexUnlock(sp->lock);
 	ss_wakeup(sp, 0);
 }
+
+/*
+ * seq_dbch_new() - Allocate a db channel for the given pv name from
+ * the program's pool. Returns NULL if out of memory.
+ */
+DBCHAN *seq_dbch_new(PROG *sp, const char *name)
+{
+	DBCHAN	*dbch = (DBCHAN *)freeListCalloc(sp->dbchPool);
+
+	if (dbch && !seq_dbch_set_name(dbch, name))
+	{
+		freeListFree(sp->dbchPool, dbch);
+		dbch = NULL;
+	}
+	return dbch;
+}
+
+/*
+ * seq_dbch_set_name() - Replace the pv name of a db channel. Short names
+ * are stored inside the db channel, so renaming a channel normally does
+ * not allocate. Everything learned from the old pv is reset. Returns
+ * FALSE if out of memory (the old name is kept).
+ */
+boolean seq_dbch_set_name(DBCHAN *dbch, const char *name)
+{
+	size_t	size = strlen(name) + 1;
+	char	*dbName = dbch->nameBuf;
+
+	if (size > sizeof(dbch->nameBuf))
+	{
+		dbName = epicsStrDup(name);
+		if (!dbName)
+			return FALSE;
+	}
+	else
+	{
+		memmove(dbch->nameBuf, name, size);
+	}
+	if (dbch->dbName != dbch->nameBuf)
+		free(dbch->dbName);
+	dbch->dbName = dbName;
+	dbch->dbCount = 0;
+	dbch->gotMonitor = FALSE;
+	dbch->wantValue = FALSE;
+	dbch->connWaiter = NULL;
+	memset(&dbch->metaData, 0, sizeof(dbch->metaData));
+	return TRUE;
+}
+
+/*
+ * seq_dbch_free() - Return a db channel to the program's pool.
+ */
+void seq_dbch_free(PROG *sp, DBCHAN *dbch)
+{
+	if (dbch->dbName != dbch->nameBuf)
+		free(dbch->dbName);
+	freeListFree(sp->dbchPool, dbch);
+}
+
+/*
+ * seq_chan_set_size() - Update the number of bytes to copy for a channel
+ * after its db channel or the db channel's element count changed.
+ */
+void seq_chan_set_size(CHAN *ch)
+{
+	/* Must take dbCount for db channels, else we overwrite
+	   elements we didn't get */
+	unsigned count = ch->dbch ? ch->dbch->dbCount : ch->count;
+
+	chHot(ch)->size = ch->type->size * count;
+}
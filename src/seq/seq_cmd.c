@@ -23,15 +23,25 @@ struct sequencerProgram {
     seqProgram *prog;
     struct program_instance *instances;
     struct sequencerProgram *next;
+    struct sequencerProgram *nextByName;
 };
 
+/* Upper limit for the number of pv systems (CA contexts) */
+#define MAX_PV_SYSTEMS 64
+
+/* Size of the program name index, must be a power of 2 */
+#define PROG_HASH_SIZE 64
+
 /* These are the only global variables in the whole seq library. */
 static struct
 {
     epicsMutexId lock;
     struct sequencerProgram *programs;
-    pvSystem pvSys;
-} globals;
+    pvSystem pvSys[MAX_PV_SYSTEMS];
+    unsigned numPvSys;
+    struct sequencerProgram *byName[PROG_HASH_SIZE];
+    seqProfile *profiles;
+} globals = {0, 0, {{0}}, 1, {0}, 0};
 
 static void seqInitPvt(void *arg)
 {
@@ -48,22 +58,78 @@ static void seqLazyInit()
     epicsThreadOnce(&seqOnceFlag, seqInitPvt, NULL);
 }
 
+/*
+ * Select the pv system for a program instance: either explicitly
+ * via the "pvsys" parameter, or by hashing program name and instance.
+ */
+static unsigned pvSystemIndex(struct program_instance *sp)
+{
+    char *str = seqMacValGet(sp, "pvsys");
+    unsigned n;
+
+    if (str && str[0] != '\0' && sscanf(str, "%u", &n) == 1)
+        return n % globals.numPvSys;
+    return epicsStrHash(sp->progName, (unsigned)sp->instance) % globals.numPvSys;
+}
+
 void createOrAttachPvSystem(struct program_instance *sp)
 {
     seqLazyInit();
     epicsMutexMustLock(globals.lock);
-    if (!pvSysIsDefined(globals.pvSys)) {
-        pvStat status = pvSysCreate(&globals.pvSys);
-        if (status != pvStatOK) {
-            errlogPrintf("getPvSystem: pvSysCreate() failure\n");
+    if (!pvSysIsDefined(sp->pvSys)) {
+        /* first thread of this program instance */
+        pvSystem *pvSys = globals.pvSys + pvSystemIndex(sp);
+
+        if (!pvSysIsDefined(*pvSys)) {
+            pvStat status = pvSysCreate(pvSys);
+            if (status != pvStatOK) {
+                errlogPrintf("getPvSystem: pvSysCreate() failure\n");
+            }
+        } else {
+            pvSysAttach(*pvSys);
         }
+        sp->pvSys = *pvSys;
     } else {
-        pvSysAttach(globals.pvSys);
+        pvSysAttach(sp->pvSys);
     }
-    sp->pvSys = globals.pvSys;
     epicsMutexUnlock(globals.lock);
 }
 
+/*
+ * Set the number of pv systems (CA contexts) that program instances
+ * are distributed over. Existing instances keep their pv system.
+ */
+epicsShareFunc void epicsShareAPI seqSetPvSystems(unsigned count)
+{
+    if (count < 1 || count > MAX_PV_SYSTEMS) {
+        errlogSevPrintf(errlogMajor,
+            "seqSetPvSystems: count must be between 1 and %d\n", MAX_PV_SYSTEMS);
+        return;
+    }
+    seqLazyInit();
+    epicsMutexMustLock(globals.lock);
+    globals.numPvSys = count;
+    epicsMutexUnlock(globals.lock);
+}
+
+static struct sequencerProgram **nameBucket(const char *progName)
+{
+    return globals.byName + (epicsStrHash(progName, 0) & (PROG_HASH_SIZE-1));
+}
+
+/* Find a registered program by name; globals.lock must be held */
+static struct sequencerProgram *findProgram(const char *progName)
+{
+    struct sequencerProgram *sp;
+
+    for (sp = *nameBucket(progName); sp; sp = sp->nextByName) {
+        if (!strcmp(progName, sp->prog->progName)) {
+            break;
+        }
+    }
+    return sp;
+}
+
 epicsShareFunc void seqRegisterSequencerProgram(seqProgram *prog)
 {
     struct sequencerProgram *sp = NULL;
@@ -79,11 +145,15 @@ epicsShareFunc void seqRegisterSequencerProgram(seqProgram *prog)
         sp = (struct sequencerProgram *)malloc(sizeof *sp);
         if (!sp) {
             errlogSevPrintf(errlogFatal, "seqRegisterSequencerProgram: out of memory");
+            epicsMutexUnlock(globals.lock);
+            return;
         }
         sp->prog = prog;
         sp->next = globals.programs;
         sp->instances = NULL;
         globals.programs = sp;
+        sp->nextByName = *nameBucket(prog->progName);
+        *nameBucket(prog->progName) = sp;
     }
     epicsMutexUnlock(globals.lock);
 }
@@ -107,6 +177,63 @@ int traverseSequencerPrograms(sequencerProgramTraversee *traversee, void *param)
     return stop;
 }
 
+/*
+ * Like traverseSequencerPrograms, but visit only the program with
+ * the given name. Does not call the traversee if there is none.
+ */
+int visitSequencerProgram(const char *progName,
+    sequencerProgramTraversee *traversee, void *param)
+{
+    struct sequencerProgram *sp;
+    int stop = FALSE;
+
+    seqLazyInit();
+    epicsMutexMustLock(globals.lock);
+    sp = findProgram(progName);
+    if (sp) {
+        stop = traversee(&sp->instances, sp->prog, param);
+    }
+    epicsMutexUnlock(globals.lock);
+    return stop;
+}
+
+/*
+ * Register the profile table of a program compiled with +p. This is
+ * called by the program's init function, that is, once per instance.
+ */
+epicsShareFunc void seq_profileRegister(seqProfile *profile)
+{
+    seqProfile *pp;
+
+    seqLazyInit();
+    epicsMutexMustLock(globals.lock);
+    foreach(pp, globals.profiles) {
+        if (pp == profile) {
+            break;
+        }
+    }
+    if (!pp) {
+        profile->next = globals.profiles;
+        globals.profiles = profile;
+    }
+    epicsMutexUnlock(globals.lock);
+}
+
+int traverseProfiles(seqProfileTraversee *traversee, void *param)
+{
+    seqProfile *pp;
+    int stop = FALSE;
+
+    seqLazyInit();
+    epicsMutexMustLock(globals.lock);
+    foreach(pp, globals.profiles) {
+        stop = traversee(pp, param);
+        if (stop) break;
+    }
+    epicsMutexUnlock(globals.lock);
+    return stop;
+}
+
 /*
  * Find a thread by name or ID number
  */
@@ -150,11 +277,7 @@ static void seqCallFunc(const iocshArgBuf *args)
         table++;
     seqLazyInit();
     epicsMutexMustLock(globals.lock);
-    foreach(sp, globals.programs) {
-        if (!strcmp(table, sp->prog->progName)) {
-            break;
-        }
-    }
+    sp = findProgram(table);
     epicsMutexUnlock(globals.lock);
     if (sp) {
         seq(sp->prog, macroDef, (unsigned)stackSize);
@@ -195,6 +318,15 @@ static void seqQueueShowCallFunc(const iocshArgBuf *args)
     }
 }
 
+/* seqProfileShow */
+static const iocshArg seqProfileShowArg0 = { "program",iocshArgString};
+static const iocshArg * const seqProfileShowArgs[1] = {&seqProfileShowArg0};
+static const iocshFuncDef seqProfileShowFuncDef = {"seqProfileShow",1,seqProfileShowArgs};
+static void seqProfileShowCallFunc(const iocshArgBuf *args)
+{
+    seqProfileShow(args[0].sval);
+}
+
 /* seqStop */
 static const iocshArg seqStopArg0 = { "program/threadID",iocshArgString};
 static const iocshArg * const seqStopArgs[1] = {&seqStopArg0};
@@ -240,6 +372,21 @@ static void seqcarCallFunc(const iocshArgBuf *args)
     seqcar(args[0].ival);
 }
 
+/* seqSetPvSystems */
+static const iocshArg seqSetPvSystemsArg0 = { "count",iocshArgInt};
+static const iocshArg * const seqSetPvSystemsArgs[1] = {&seqSetPvSystemsArg0};
+static const iocshFuncDef seqSetPvSystemsFuncDef = {"seqSetPvSystems",1,seqSetPvSystemsArgs};
+static void seqSetPvSystemsCallFunc(const iocshArgBuf *args)
+{
+    int count = args[0].ival;
+
+    if (count < 0) {
+        printf("Count must be a positive integer.\n");
+        return;
+    }
+    seqSetPvSystems((unsigned)count);
+}
+
 /*
  * This routine is called before multitasking has started, so there's
  * no race condition in the test/set of firstTime.
@@ -252,8 +399,10 @@ epicsShareFunc void seqRegisterSequencerCommands(void)
         iocshRegister(&seqFuncDef,seqCallFunc);
         iocshRegister(&seqShowFuncDef,seqShowCallFunc);
         iocshRegister(&seqQueueShowFuncDef,seqQueueShowCallFunc);
+        iocshRegister(&seqProfileShowFuncDef,seqProfileShowCallFunc);
         iocshRegister(&seqStopFuncDef,seqStopCallFunc);
         iocshRegister(&seqChanShowFuncDef,seqChanShowCallFunc);
         iocshRegister(&seqcarFuncDef,seqcarCallFunc);
+        iocshRegister(&seqSetPvSystemsFuncDef,seqSetPvSystemsCallFunc);
     }
 }
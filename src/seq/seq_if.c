@@ -33,6 +33,21 @@ in the file LICENSE that is included with this distribution.
 #include "seq.h"
 #include "seq_debug.h"
 
+/* One channel of an assign operation, see assign */
+struct assign_op
+{
+	CHAN		*ch;		/* channel to assign */
+	const char	*pvName;	/* new pv name */
+	DBCHAN		*dbch;		/* old, later new db channel */
+	boolean		changed;	/* new name differs from the old one */
+	boolean		shared;		/* old db channel must leave its pv */
+	boolean		create;		/* new db channel must join its pv */
+	pvStat		status;
+};
+
+static boolean flush_put_before(SS_ID ss, CHAN *ch);
+static pvStat assign(SS_ID ss, struct assign_op *op, unsigned num);
+
 static void completion_failure(pvEventType evtype, PVMETA *meta)
 {
 	meta->status = pvStatERROR;
@@ -51,7 +66,7 @@ static void pv_call_failure(DBCHAN *dbch, PVMETA *meta, pvStat status)
 {
 	meta->status = status;
 	meta->severity = pvSevrERROR;
-	meta->message = pvVarGetMess(dbch->pvid);
+	meta->message = pvVarGetMess(*dbch->pvid);
 }
 
 static pvStat check_connected(DBCHAN *dbch, PVMETA *meta)
@@ -69,10 +84,78 @@ static pvStat check_connected(DBCHAN *dbch, PVMETA *meta)
 	}
 }
 
+/* Return the request slot of channel ch in state set ss (see seq_ss_slot).
+   Only channel ids computed by escaped C code can lack one. */
+static unsigned req_slot(SS_ID ss, CHAN *ch, const char *what)
+{
+	unsigned slot = seq_ss_slot(ss, chNum(ch));
+
+	if (slot == NO_SLOT)
+		errlogSevPrintf(errlogMajor,
+			"%s(%s): user error (channel not used by state set %s)\n",
+			what, ch->varName, ss->ssName);
+	return slot;
+}
+
+/* Return the number of pending requests among numReqs request slots */
+static unsigned num_pending(PVREQ **req, unsigned numReqs)
+{
+	unsigned n, count = 0;
+
+	for (n = 0; n < numReqs; n++)
+		if (req[n])
+			count++;
+	return count;
+}
+
+/* Return a free request slot, or NULL if all are in use */
+static PVREQ **free_slot(PVREQ **req, unsigned numReqs)
+{
+	unsigned n;
+
+	for (n = 0; n < numReqs; n++)
+		if (!req[n])
+			return req + n;
+	return NULL;
+}
+
+/* Cancel all pending requests among numReqs request slots */
+static void cancel_all(PVREQ **req, unsigned numReqs)
+{
+	unsigned n;
+
+	for (n = 0; n < numReqs; n++)
+		req[n] = NULL;
+}
+
+/* Cancel the pending requests of all state sets for a channel, so that
+   their completions get ignored, and wake up state sets that wait for
+   them. Must be called with the program lock held. */
+static void cancel_chan_requests(PROG *sp, CHAN *ch)
+{
+	unsigned nss;
+
+	for (nss = 0; nss < sp->numSS; nss++)
+	{
+		SSCB *ss = sp->ss + nss;
+		unsigned slot = seq_ss_slot(ss, chNum(ch));
+
+		if (slot == NO_SLOT)
+			continue;
+		if (ss->getReq[slot] || num_pending(putReqs(ss,slot), sp->maxPuts))
+		{
+			ss->getReq[slot] = NULL;
+			cancel_all(putReqs(ss,slot), sp->maxPuts);
+			epicsEventSignal(ss->syncSem);
+		}
+	}
+}
+
 static pvStat check_pending(
 	pvEventType evtype,
 	SS_ID ss,
 	PVREQ **req,
+	unsigned numReqs,
 	const char *varName,
 	DBCHAN *dbch,
 	PVMETA *meta,
@@ -91,7 +174,7 @@ static pvStat check_pending(
 				call, varName, tmo);
 			return pvStatERROR;
 		}
-		while (*req)
+		while (num_pending(req, numReqs))
 		{
 			/* a request is already pending (must be an async request) */
 			double before, after;
@@ -127,7 +210,7 @@ static pvStat check_pending(
 	}
 	else if (compType == ASYNC)
 	{
-		if (*req) {
+		if (numReqs == 1 && *req) {
 			errlogSevPrintf(errlogMajor,
 				"%s(ss %s, var %s, pv %s): user error "
 				"(there is already a %s pending for this channel/"
@@ -136,6 +219,15 @@ static pvStat check_pending(
 			);
 			return pvStatERROR;
 		}
+		if (!free_slot(req, numReqs)) {
+			errlogSevPrintf(errlogMajor,
+				"%s(ss %s, var %s, pv %s): user error "
+				"(there are already %u %ss pending for this channel/"
+				"state set combination)\n",
+				call, ss->ssName, varName, dbch->dbName, numReqs, call
+			);
+			return pvStatERROR;
+		}
 	}
 	return pvStatOK;
 }
@@ -144,25 +236,26 @@ static pvStat wait_complete(
 	pvEventType evtype,
 	SS_ID ss,
 	PVREQ **req,
+	unsigned numReqs,
 	DBCHAN *dbch,
 	PVMETA *meta,
 	double tmo)
 {
 	const char *call = evtype == pvEventGet ? "pvGet" : "pvPut";
-	while (*req)
+	while (num_pending(req, numReqs))
 	{
 		switch (epicsEventWaitWithTimeout(ss->syncSem, tmo))
 		{
 		case epicsEventWaitOK:
 			break;
 		case epicsEventWaitTimeout:
-			*req = NULL;			/* cancel the request */
+			cancel_all(req, numReqs);	/* cancel the request */
 			completion_timeout(evtype, meta);
 			return meta->status;
 		case epicsEventWaitError:
 			errlogSevPrintf(errlogFatal,
 				"%s: epicsEventWaitWithTimeout() failure\n", call);
-			*req = NULL;			/* cancel the request */
+			cancel_all(req, numReqs);	/* cancel the request */
 			completion_failure(evtype, meta);
 			return meta->status;
 		}
@@ -170,6 +263,75 @@ static pvStat wait_complete(
 	return check_connected(dbch, meta);
 }
 
+/*
+ * Satisfy a synchronous get from the most recent monitor event, if the
+ * channel is monitored, connected, and has received a monitor since then.
+ * Queued channels don't qualify, since their monitors go to the queue.
+ * This needs safe mode: only there the monitored value is kept apart
+ * from the variable, in traditional mode the program may have
+ * overwritten it since the last monitor event.
+ */
+static boolean get_from_monitor(SS_ID ss, CHAN *ch)
+{
+	PROG	*sp = ss->prog;
+	DBCHAN	*dbch;
+	boolean	cached;
+
+	if (!ch->monitored || ch->queue)
+		return FALSE;
+
+	epicsMutexMustLock(sp->lock);
+	dbch = ch->dbch;
+	cached = dbch && dbch->connected && dbch->gotMonitor;
+	if (cached)
+		sp->cachedGetCount++;
+	epicsMutexUnlock(sp->lock);
+
+	if (cached)
+		/* Copy regardless of whether dirty flag is set or not */
+		ss_read_buffer(ss, ch, FALSE);
+	return cached;
+}
+
+/*
+ * Connect a lazy channel (+z) on first use and wait at most tmo seconds
+ * for the connection. Returns the channel's db channel, or NULL if it
+ * could not be created.
+ */
+static DBCHAN *connect_lazy(SS_ID ss, CHAN *ch, double tmo)
+{
+	PROG	*sp = ss->prog;
+	DBCHAN	*dbch;
+	double	start, now;
+
+	/* The connection handler signals us directly, the wakeup of all
+	   state sets may be delayed, see conn_wakeup in seq_ca.c */
+	epicsMutexMustLock(sp->lock);
+	dbch = ch->dbch;
+	if (dbch && dbch->lazy)
+		dbch->connWaiter = ss;
+	epicsMutexUnlock(sp->lock);
+
+	if (seq_connect_lazy(ch))
+	{
+		pvSysFlush(sp->pvSys);
+		pvTimeGetCurrentDouble(&start);
+		now = start;
+		while (!ch->dbch->connected && now - start < tmo)
+		{
+			epicsEventWaitWithTimeout(ss->syncSem, tmo - (now - start));
+			pvTimeGetCurrentDouble(&now);
+		}
+	}
+
+	epicsMutexMustLock(sp->lock);
+	dbch = ch->dbch;
+	if (dbch && dbch->connWaiter == ss)
+		dbch->connWaiter = NULL;
+	epicsMutexUnlock(sp->lock);
+	return dbch;
+}
+
 /*
  * Get value from a channel.
  */
@@ -179,21 +341,25 @@ epicsShareFunc pvStat seq_pvGet(SS_ID ss, CH_ID chId, enum compType compType)
 }
 
 /*
- * Get value from a channel, with timeout.
+ * Get value from a channel, with timeout. The mode is passed in, so
+ * that the compiler can specialize this for safe and traditional mode.
  */
-epicsShareFunc pvStat seq_pvGetTmo(SS_ID ss, CH_ID chId, enum compType compType, double tmo)
+static pvStat pv_get_tmo(SS_ID ss, CH_ID chId, enum compType compType,
+	double tmo, boolean safe)
 {
 	PROG		*sp = ss->prog;
 	CHAN		*ch = sp->chan + chId;
 	pvStat		status;
 	PVREQ		*req;
 	DBCHAN		*dbch = ch->dbch;
-	PVMETA		*meta = metaPtr(ch,ss);
+	PVMETA		*meta = seq_ss_meta(ss,ch);
+	unsigned	slot;
+	boolean		flushed;
 
 	/* Anonymous PV and safe mode, just copy from shared buffer.
 	   Note that completion is always immediate, so no distinction
 	   between SYNC and ASYNC needed. See also pvGetComplete. */
-	if (optTest(sp, OPT_SAFE) && !dbch)
+	if (safe && !dbch)
 	{
 		/* Copy regardless of whether dirty flag is set or not */
 		ss_read_buffer(ss, ch, FALSE);
@@ -208,13 +374,35 @@ epicsShareFunc pvStat seq_pvGetTmo(SS_ID ss, CH_ID chId, enum compType compType,
 		);
 		return pvStatERROR;
 	}
+	slot = req_slot(ss, ch, "pvGet");
+	if (slot == NO_SLOT)
+		return pvStatERROR;
+	if (dbch->lazy)
+	{
+		dbch = connect_lazy(ss, ch, tmo);
+		if (!dbch)
+			return pvStatERROR;
+	}
 
 	if (compType == DEFAULT)
 	{
 		compType = optTest(sp, OPT_ASYNC) ? ASYNC : SYNC;
 	}
 
-	status = check_pending(pvEventGet, ss, ss->getReq + chId, ch->varName,
+	/* A get must see the result of a staged put */
+	flushed = flush_put_before(ss, ch);
+
+	/* Synchronous get on a monitored channel in safe mode: if the program
+	   asked for it, skip the round-trip and use the value from the last
+	   monitor event, unless that is older than a put we just sent */
+	if (compType == CACHED || (compType == SYNC && optTest(sp, OPT_CACHEGET)))
+	{
+		compType = SYNC;
+		if (safe && !flushed && !ss->getReq[slot] && get_from_monitor(ss, ch))
+			return pvStatOK;
+	}
+
+	status = check_pending(pvEventGet, ss, ss->getReq + slot, 1, ch->varName,
 		dbch, meta, compType, tmo);
 	if (status != pvStatOK)
 		return status;
@@ -224,13 +412,13 @@ epicsShareFunc pvStat seq_pvGetTmo(SS_ID ss, CH_ID chId, enum compType compType,
 	req->ss = ss;
 	req->ch = ch;
 
-	assert(ss->getReq[chId] == NULL);
-	ss->getReq[chId] = req;
+	assert(ss->getReq[slot] == NULL);
+	ss->getReq[slot] = req;
 
 	/* Perform the PV get operation with a callback routine specified.
 	   Requesting more than db channel has available is ok. */
 	status = pvVarGetCallback(
-			&dbch->pvid,		/* PV id */
+			dbch->pvid,		/* PV id */
 			ch->type->getType,	/* request type */
 			ch->count,		/* element count */
 			req);			/* user arg */
@@ -239,8 +427,8 @@ epicsShareFunc pvStat seq_pvGetTmo(SS_ID ss, CH_ID chId, enum compType compType,
 		pv_call_failure(dbch, meta, status);
 		errlogSevPrintf(errlogFatal,
 			"pvGet(var %s, pv %s): pvVarGetCallback() failure: %s\n",
-			ch->varName, dbch->dbName, pvVarGetMess(dbch->pvid));
-		ss->getReq[chId] = NULL;	/* cancel the request */
+			ch->varName, dbch->dbName, pvVarGetMess(*dbch->pvid));
+		ss->getReq[slot] = NULL;	/* cancel the request */
 		freeListFree(sp->pvReqPool, req);
 		check_connected(dbch, meta);
 		return status;
@@ -250,10 +438,10 @@ epicsShareFunc pvStat seq_pvGetTmo(SS_ID ss, CH_ID chId, enum compType compType,
 	if (compType == SYNC)
 	{
 		pvSysFlush(sp->pvSys);
-		status = wait_complete(pvEventGet, ss, ss->getReq + chId, dbch, meta, tmo);
+		status = wait_complete(pvEventGet, ss, ss->getReq + slot, 1, dbch, meta, tmo);
 		if (status != pvStatOK)
 			return status;
-		if (optTest(sp, OPT_SAFE))
+		if (safe)
 			/* Copy regardless of whether dirty flag is set or not */
 			ss_read_buffer(ss, ch, FALSE);
 	}
@@ -261,6 +449,23 @@ epicsShareFunc pvStat seq_pvGetTmo(SS_ID ss, CH_ID chId, enum compType compType,
 	return pvStatOK;
 }
 
+epicsShareFunc pvStat seq_pvGetTmo(SS_ID ss, CH_ID chId, enum compType compType, double tmo)
+{
+	return pv_get_tmo(ss, chId, compType, tmo, optTest(ss->prog, OPT_SAFE));
+}
+
+/* Variants for code generated by snc, which knows at compile time
+   whether the program runs in safe mode, see seq_snc.h */
+epicsShareFunc pvStat seq_pvGetTmoSafe(SS_ID ss, CH_ID chId, enum compType compType, double tmo)
+{
+	return pv_get_tmo(ss, chId, compType, tmo, TRUE);
+}
+
+epicsShareFunc pvStat seq_pvGetTmoTrad(SS_ID ss, CH_ID chId, enum compType compType, double tmo)
+{
+	return pv_get_tmo(ss, chId, compType, tmo, FALSE);
+}
+
 /*
  * Return whether the last get completed. In safe mode, as a
  * side effect, copy value from shared buffer to state set local buffer.
@@ -271,6 +476,7 @@ epicsShareFunc boolean seq_pvGetComplete(
 {
 	PROG	*sp = ss->prog;
 	CHAN	*ch = sp->chan + chId;
+	unsigned slot;
 
 	if (!ch->dbch)
 	{
@@ -281,9 +487,10 @@ epicsShareFunc boolean seq_pvGetComplete(
 				ch->varName);
 		return TRUE;
 	}
-	else if (!ss->getReq[chId])
+	slot = req_slot(ss, ch, "pvGetComplete");
+	if (slot == NO_SLOT || !ss->getReq[slot])
 	{
-		pvStat status = check_connected(ch->dbch, metaPtr(ch,ss));
+		pvStat status = check_connected(ch->dbch, seq_ss_meta(ss,ch));
 		if (status == pvStatOK && optTest(sp, OPT_SAFE))
 		{
 			/* In safe mode, copy value and meta data from shared buffer
@@ -341,6 +548,7 @@ epicsShareFunc void seq_pvGetCancel(
 {
 	PROG	*sp = ss->prog;
 	CHAN	*ch = sp->chan + chId;
+	unsigned slot;
 
 	if (!ch->dbch)
 	{
@@ -349,9 +557,9 @@ epicsShareFunc void seq_pvGetCancel(
 				"pvGetCancel(%s): user error (not assigned to a PV)\n",
 				ch->varName);
 	}
-	else
+	else if ((slot = req_slot(ss, ch, "pvGetCancel")) != NO_SLOT)
 	{
-		ss->getReq[chId] = NULL;	/* cancel the request */
+		ss->getReq[slot] = NULL;	/* cancel the request */
 	}
 }
 
@@ -381,7 +589,7 @@ static void *putq_cp(void *dest, const void *src, size_t elemSize)
 	struct putq_cp_arg *arg = (struct putq_cp_arg *)src;
 	CHAN *ch = arg->ch;
 
-	return memcpy(pv_value_ptr(dest, ch->type->getType), /*BUG? should that be putType?*/
+	return copyValue(pv_value_ptr(dest, ch->type->getType), /*BUG? should that be putType?*/
 		arg->var, ch->type->size * ch->count);
 }
 
@@ -402,9 +610,11 @@ static void anonymous_put(SS_ID ss, CHAN *ch)
 		print_channel_value(DEBUG, ch, var);
 
 		/* Note: Must lock here because multiple state sets can issue
-		   pvPut calls concurrently. OTOH, no need to lock against CA
-		   callbacks, because anonymous and named PVs are disjoint. */
-		epicsMutexMustLock(ch->varLock);
+		   pvPut calls concurrently, unless only one state set puts to
+		   the queue. OTOH, no need to lock against CA callbacks,
+		   because anonymous and named PVs are disjoint. */
+		if (!ch->singlePutter)
+			epicsMutexMustLock(ch->varLock);
 
 		full = seqQueuePutF(queue, putq_cp, &arg);
 		if (full)
@@ -416,18 +626,121 @@ static void anonymous_put(SS_ID ss, CHAN *ch)
 			);
 		}
 
-		epicsMutexUnlock(ch->varLock);
+		if (!ch->singlePutter)
+			epicsMutexUnlock(ch->varLock);
 	}
 	else
 	{
 		/* Set dirty flag only if monitored */
-		ss_write_buffer(ch, var, 0, ch->monitored);
+		ss_write_buffer(ss, ch, var, 0, ch->monitored);
 	}
 	/* If there's an event flag associated with this channel, set it */
 	if (ch->syncedTo)
 		seq_efSet(ss, ch->syncedTo);
 	/* Wake up each state set that uses this channel in an event */
-	ss_wakeup(ss->prog, ch->eventNum);
+	ss_wakeup(ss->prog, chHot(ch)->eventNum);
+}
+
+/*
+ * Stage a fire-and-forget put (+b). The value is copied to a per channel
+ * buffer; a put that is already staged for this channel is superseded.
+ * The actual put is issued by ss_flush_puts at the end of the action.
+ */
+static pvStat stage_put(SS_ID ss, CHAN *ch, const char *var)
+{
+	ptrdiff_t nch = chNum(ch);
+	size_t size = ch->type->size * ch->count;
+
+	if (!ss->putBuf[nch])
+	{
+		ss->putBuf[nch] = newArray(char, size);
+		if (!ss->putBuf[nch])
+		{
+			errlogSevPrintf(errlogFatal, "pvPut: calloc failed\n");
+			return pvStatERROR;
+		}
+	}
+	copyValue(ss->putBuf[nch], var, size);
+	if (ss->staged[nch])
+	{
+		ss->combinedPuts++;
+	}
+	else
+	{
+		ss->staged[nch] = TRUE;
+		ss->stagedChans[ss->numStaged++] = (unsigned)nch;
+	}
+	return pvStatOK;
+}
+
+/*
+ * Issue the staged put for a channel, if any.
+ */
+static pvStat flush_put(SS_ID ss, CHAN *ch)
+{
+	ptrdiff_t nch = chNum(ch);
+	DBCHAN	*dbch = ch->dbch;
+	pvStat	status;
+
+	if (!ss->staged || !ss->staged[nch])
+		return pvStatOK;
+	ss->staged[nch] = FALSE;
+
+	/* channel may have been de-assigned in the mean time */
+	if (!dbch)
+		return pvStatOK;
+
+	status = pvVarPutNoBlock(
+			dbch->pvid,		/* PV id */
+			ch->type->putType,	/* data type */
+			dbch->dbCount,		/* element count */
+			(pvValue *)ss->putBuf[nch]);	/* data value */
+	if (status != pvStatOK)
+	{
+		pv_call_failure(dbch, seq_ss_meta(ss,ch), status);
+		errlogSevPrintf(errlogFatal, "pvPut(var %s, pv %s): pvVarPutNoBlock() failure: %s\n",
+			ch->varName, dbch->dbName, pvVarGetMess(*dbch->pvid));
+	}
+	return status;
+}
+
+/*
+ * Issue the staged put for a channel before any other request
+ * for the same channel, so that requests stay in order. Return
+ * whether there was a staged put.
+ */
+static boolean flush_put_before(SS_ID ss, CHAN *ch)
+{
+	unsigned n;
+
+	if (!ss->staged || !ss->staged[chNum(ch)])
+		return FALSE;
+	flush_put(ss, ch);
+	for (n = 0; n < ss->numStaged; n++)
+	{
+		if (ss->stagedChans[n] == (unsigned)chNum(ch))
+		{
+			ss->stagedChans[n] = ss->stagedChans[--ss->numStaged];
+			break;
+		}
+	}
+	return TRUE;
+}
+
+/*
+ * Issue all staged puts of a state set. Called at the end of each
+ * action, entry, and exit block.
+ */
+void ss_flush_puts(SSCB *ss)
+{
+	PROG	*sp = ss->prog;
+	unsigned n;
+
+	if (!optTest(sp, OPT_COMBINE))
+		return;
+	for (n = 0; n < ss->numStaged; n++)
+		flush_put(ss, sp->chan + ss->stagedChans[n]);
+	ss->numStaged = 0;
 }
 
 /*
@@ -439,23 +752,26 @@ epicsShareFunc pvStat seq_pvPut(SS_ID ss, CH_ID chId, enum compType compType)
 }
 
 /*
- * Put a variable's value to a PV, with timeout.
+ * Put a variable's value to a PV, with timeout (mode passed in
+ * like for pv_get_tmo).
  */
-epicsShareFunc pvStat seq_pvPutTmo(SS_ID ss, CH_ID chId, enum compType compType, double tmo)
+static pvStat pv_put_tmo(SS_ID ss, CH_ID chId, enum compType compType,
+	double tmo, boolean safe)
 {
 	PROG	*sp = ss->prog;
 	CHAN	*ch = sp->chan + chId;
 	pvStat	status;
 	unsigned count;
 	char	*var = valPtr(ch,ss);	/* ptr to value */
-	PVREQ	*req;
+	PVREQ	*req, **slot;
 	DBCHAN	*dbch = ch->dbch;
-	PVMETA	*meta = metaPtr(ch,ss);
+	PVMETA	*meta = seq_ss_meta(ss,ch);
+	unsigned slotNum;
 
 	DEBUG("pvPut: pv name=%s, var=%p\n", dbch ? dbch->dbName : "<anonymous>", var);
 
 	/* First handle anonymous PV (safe mode only) */
-	if (optTest(sp, OPT_SAFE) && !dbch)
+	if (safe && !dbch)
 	{
 		anonymous_put(ss, ch);
 		return pvStatOK;
@@ -468,15 +784,32 @@ epicsShareFunc pvStat seq_pvPutTmo(SS_ID ss, CH_ID chId, enum compType compType,
 		);
 		return pvStatERROR;
 	}
+	slotNum = req_slot(ss, ch, "pvPut");
+	if (slotNum == NO_SLOT)
+		return pvStatERROR;
+	if (dbch->lazy)
+	{
+		dbch = connect_lazy(ss, ch, tmo);
+		if (!dbch)
+			return pvStatERROR;
+	}
 
 	/* Check for channel connected */
 	status = check_connected(dbch, meta);
 	if (status != pvStatOK) return status;
 
+	/* There is nothing to cache for a put */
+	if (compType == CACHED)
+		compType = SYNC;
+
+	/* A put with completion must not overtake a staged put */
+	if (compType != DEFAULT)
+		flush_put_before(ss, ch);
+
 	/* Determine whether to perform synchronous, asynchronous, or
 	   plain put ((+a) option was never honored for put, so DEFAULT
 	   means fire-and-forget) */
-	status = check_pending(pvEventPut, ss, ss->putReq + chId, ch->varName,
+	status = check_pending(pvEventPut, ss, putReqs(ss,slotNum), sp->maxPuts, ch->varName,
 		dbch, meta, compType, tmo);
 	if (status != pvStatOK)
 		return status;
@@ -487,10 +820,14 @@ epicsShareFunc pvStat seq_pvPutTmo(SS_ID ss, CH_ID chId, enum compType compType,
 
 	/* Perform the PV put operation (either non-blocking or with a
 	   callback routine specified) */
-	if (compType == DEFAULT)
+	if (compType == DEFAULT && optTest(sp, OPT_COMBINE))
+	{
+		return stage_put(ss, ch, var);
+	}
+	else if (compType == DEFAULT)
 	{
 		status = pvVarPutNoBlock(
-				&dbch->pvid,		/* PV id */
+				dbch->pvid,		/* PV id */
 				ch->type->putType,	/* data type */
 				count,			/* element count */
 				(pvValue *)var);	/* data value */
@@ -498,7 +835,7 @@ epicsShareFunc pvStat seq_pvPutTmo(SS_ID ss, CH_ID chId, enum compType compType,
 		{
 			pv_call_failure(dbch, meta, status);
 			errlogSevPrintf(errlogFatal, "pvPut(var %s, pv %s): pvVarPutNoBlock() failure: %s\n",
-				ch->varName, dbch->dbName, pvVarGetMess(dbch->pvid));
+				ch->varName, dbch->dbName, pvVarGetMess(*dbch->pvid));
 			return status;
 		}
 	}
@@ -509,11 +846,12 @@ epicsShareFunc pvStat seq_pvPutTmo(SS_ID ss, CH_ID chId, enum compType compType,
 		req->ss = ss;
 		req->ch = ch;
 
-		assert(ss->putReq[chId] == NULL);
-		ss->putReq[chId] = req;
+		slot = free_slot(putReqs(ss,slotNum), sp->maxPuts);
+		assert(slot);
+		*slot = req;
 
 		status = pvVarPutCallback(
-				&dbch->pvid,		/* PV id */
+				dbch->pvid,		/* PV id */
 				ch->type->putType,	/* data type */
 				count,			/* element count */
 				(pvValue *)var,		/* data value */
@@ -522,8 +860,8 @@ epicsShareFunc pvStat seq_pvPutTmo(SS_ID ss, CH_ID chId, enum compType compType,
 		{
 			pv_call_failure(dbch, meta, status);
 			errlogSevPrintf(errlogFatal, "pvPut(var %s, pv %s): pvVarPutCallback() failure: %s\n",
-				ch->varName, dbch->dbName, pvVarGetMess(dbch->pvid));
-			ss->putReq[chId] = NULL;	/* cancel the request */
+				ch->varName, dbch->dbName, pvVarGetMess(*dbch->pvid));
+			*slot = NULL;			/* cancel the request */
 			freeListFree(sp->pvReqPool, req);
 			check_connected(dbch, meta);
 			return status;
@@ -532,7 +870,8 @@ epicsShareFunc pvStat seq_pvPutTmo(SS_ID ss, CH_ID chId, enum compType compType,
 		if (compType == SYNC)			/* wait for completion */
 		{
 			pvSysFlush(sp->pvSys);
-			status = wait_complete(pvEventPut, ss, ss->putReq + chId, dbch, meta, tmo);
+			/* a timeout must cancel only this request */
+			status = wait_complete(pvEventPut, ss, slot, 1, dbch, meta, tmo);
 			if (status != pvStatOK)
 				return status;
 		}
@@ -540,6 +879,21 @@ epicsShareFunc pvStat seq_pvPutTmo(SS_ID ss, CH_ID chId, enum compType compType,
 	return pvStatOK;
 }
 
+epicsShareFunc pvStat seq_pvPutTmo(SS_ID ss, CH_ID chId, enum compType compType, double tmo)
+{
+	return pv_put_tmo(ss, chId, compType, tmo, optTest(ss->prog, OPT_SAFE));
+}
+
+epicsShareFunc pvStat seq_pvPutTmoSafe(SS_ID ss, CH_ID chId, enum compType compType, double tmo)
+{
+	return pv_put_tmo(ss, chId, compType, tmo, TRUE);
+}
+
+epicsShareFunc pvStat seq_pvPutTmoTrad(SS_ID ss, CH_ID chId, enum compType compType, double tmo)
+{
+	return pv_put_tmo(ss, chId, compType, tmo, FALSE);
+}
+
 /*
  * Return whether the last put completed.
  */
@@ -554,7 +908,7 @@ epicsShareFunc boolean seq_pvPutComplete(
 }
 
 /*
- * Return whether the last put completed.
+ * Return whether all pending puts completed.
  */
 static boolean seq_pvSinglePutComplete(
 	SS_ID	ss,
@@ -562,6 +916,7 @@ static boolean seq_pvSinglePutComplete(
 {
 	PROG	*sp = ss->prog;
 	CHAN	*ch = sp->chan + chId;
+	unsigned slot;
 
 	if (!ch->dbch)
 	{
@@ -572,9 +927,10 @@ static boolean seq_pvSinglePutComplete(
 				ch->varName);
 		return TRUE;
 	}
-	else if (!ss->putReq[chId])
+	slot = req_slot(ss, ch, "pvPutComplete");
+	if (slot == NO_SLOT || !num_pending(putReqs(ss,slot), sp->maxPuts))
 	{
-		check_connected(ch->dbch, metaPtr(ch,ss));
+		check_connected(ch->dbch, seq_ss_meta(ss,ch));
 		return TRUE;
 	}
 
@@ -618,7 +974,26 @@ epicsShareFunc boolean seq_pvArrayPutComplete(
 }
 
 /*
- * Cancel the last asynchronous put request.
+ * Return the number of pending asynchronous put requests.
+ */
+epicsShareFunc unsigned seq_pvPutPending(
+	SS_ID	ss,
+	CH_ID	chId)
+{
+	PROG	*sp = ss->prog;
+	CHAN	*ch = sp->chan + chId;
+	unsigned slot;
+
+	if (!ch->dbch)
+		return 0;
+	slot = req_slot(ss, ch, "pvPutPending");
+	if (slot == NO_SLOT)
+		return 0;
+	return num_pending(putReqs(ss,slot), sp->maxPuts);
+}
+
+/*
+ * Cancel all pending asynchronous put requests.
  */
 epicsShareFunc void seq_pvPutCancel(
 	SS_ID	ss,
@@ -626,6 +1001,7 @@ epicsShareFunc void seq_pvPutCancel(
 {
 	PROG	*sp = ss->prog;
 	CHAN	*ch = sp->chan + chId;
+	unsigned slot;
 
 	if (!ch->dbch)
 	{
@@ -634,9 +1010,9 @@ epicsShareFunc void seq_pvPutCancel(
 				"pvPutCancel(%s): user error (not assigned to a PV)\n",
 				ch->varName);
 	}
-	else
+	else if ((slot = req_slot(ss, ch, "pvPutCancel")) != NO_SLOT)
 	{
-		ss->putReq[chId] = NULL;	/* cancel the request */
+		cancel_all(putReqs(ss,slot), sp->maxPuts);	/* cancel the requests */
 	}
 }
 
@@ -663,10 +1039,18 @@ epicsShareFunc void seq_pvArrayPutCancel(
  */
 epicsShareFunc pvStat seq_pvAssignSubst(SS_ID ss, CH_ID chId, const char *pvName)
 {
-	char	new_pv_name[100];
+	char	*tmp;
+	const char *new_pv_name = seqMacEval(ss->prog, pvName, TRUE, &tmp);
+	pvStat	status;
 
-	seqMacEval(ss->prog, pvName, new_pv_name, sizeof(new_pv_name));
-	return seq_pvAssign(ss, chId, new_pv_name);
+	if (!new_pv_name)
+	{
+		errlogSevPrintf(errlogFatal, "pvAssignSubst: out of memory\n");
+		return pvStatERROR;
+	}
+	status = seq_pvAssign(ss, chId, new_pv_name);
+	free(tmp);
+	return status;
 }
 
 /*
@@ -676,103 +1060,209 @@ epicsShareFunc pvStat seq_pvAssignSubst(SS_ID ss, CH_ID chId, const char *pvName
  */
 epicsShareFunc pvStat seq_pvAssign(SS_ID ss, CH_ID chId, const char *pvName)
 {
-	PROG	*sp = ss->prog;
-	CHAN	*ch = sp->chan + chId;
-	pvStat	status = pvStatOK;
-	DBCHAN	*dbch;
+	struct assign_op op;
 
-	if (!pvName) pvName = "";
+	memset(&op, 0, sizeof(op));
+	op.ch = ss->prog->chan + chId;
+	op.pvName = pvName;
+	return assign(ss, &op, 1);
+}
 
-	DEBUG("Assign %s to \"%s\"\n", ch->varName, pvName);
+/*
+ * Assign/Connect the first length elements of a channel array
+ * to the pv names in the given array, then flush once.
+ */
+epicsShareFunc pvStat seq_pvArrayAssign(
+	SS_ID		ss,
+	CH_ID		chId,
+	unsigned	length,
+	string		*pvNames)
+{
+	PROG		*sp = ss->prog;
+	struct assign_op *op;
+	pvStat		status;
+	unsigned	n;
 
-	epicsMutexMustLock(sp->lock);
+	if (length == 0)
+		return pvStatOK;
+	op = newArray(struct assign_op, length);
+	if (!op)
+	{
+		errlogSevPrintf(errlogFatal, "pvArrayAssign: out of memory\n");
+		return pvStatERROR;
+	}
+	for (n = 0; n < length; n++)
+	{
+		op[n].ch = sp->chan + chId + n;
+		op[n].pvName = pvNames[n];
+	}
+	status = assign(ss, op, length);
+	free(op);
+	pvSysFlush(sp->pvSys);
+	return status;
+}
 
-	dbch = ch->dbch;
+/*
+ * Common part of pvAssign and pvArrayAssign. Db channel structures are
+ * taken from and returned to a pool, and renamed in place on reassign.
+ * Reassigning a channel to the name it already has does nothing.
+ *
+ * The bookkeeping for all channels is done in a few passes, each under
+ * a single hold of the program lock. Channels leave and join their
+ * shared pvs in between, because seq_share.c must not be called with
+ * the program lock held.
+ */
+static pvStat assign(SS_ID ss, struct assign_op *op, unsigned num)
+{
+	PROG	*sp = ss->prog;
+	pvStat	status = pvStatOK;
+	unsigned n;
 
-	if (dbch)	/* was assigned to a named PV */
+	epicsMutexMustLock(sp->lock);
+	for (n = 0; n < num; n++)
 	{
-		ch->dbch = 0;
-
-		epicsMutexUnlock(sp->lock);
+		DBCHAN *dbch = op[n].ch->dbch;
 
-		status = pvVarDestroy(&dbch->pvid);
+		if (!op[n].pvName) op[n].pvName = "";
+		DEBUG("Assign %s to \"%s\"\n", op[n].ch->varName, op[n].pvName);
+		op[n].changed = !dbch || strcmp(dbch->dbName, op[n].pvName) != 0;
+	}
+	epicsMutexUnlock(sp->lock);
 
-		epicsMutexMustLock(sp->lock);
+	/* A staged put belongs to the old PV */
+	for (n = 0; n < num; n++)
+	{
+		if (op[n].changed)
+			flush_put_before(ss, op[n].ch);
+	}
 
-		sp->assignCount--;
+	/* Detach the old db channels */
+	epicsMutexMustLock(sp->lock);
+	for (n = 0; n < num; n++)
+	{
+		CHAN	*ch = op[n].ch;
+		DBCHAN	*dbch = ch->dbch;
 
-		if (dbch->connected)	/* see connection handler */
+		if (!op[n].changed)
+			continue;
+		op[n].dbch = dbch;
+		if (dbch && dbch->lazy)	/* was assigned but never used */
 		{
-			dbch->connected = FALSE;
-			sp->connectCount--;
-
-			/* Must not call seq_camonitor(ch, FALSE), it would give an
-			error because channel is already dead. pvVarDestroy takes
-                        care that the monid inside the pvid gets invalidated. */
-
-			/* Note ch->monitored remains on because it is a configuration
-			value that belongs to the variable and newly created channels
-			for the same variable should inherit this configuration. */
+			ch->dbch = 0;
+			dbch->lazy = FALSE;
+			sp->lazyCount--;
+			sp->assignCount--;
+			/* the new channel is not lazy, see seq_connect_lazy */
+			if (ch->monitored)
+				sp->monitorCount++;
 		}
-
-		if (status != pvStatOK)
+		else if (dbch)	/* was assigned to a named PV */
 		{
-			errlogSevPrintf(errlogFatal, "pvAssign(var %s, pv %s): pvVarDestroy() failure: "
-				"%s\n", ch->varName, dbch->dbName, pvVarGetMess(dbch->pvid));
-		}
+			ch->dbch = 0;
+			op[n].shared = TRUE;
 
-		free(dbch->dbName);
+			/* The old PV may be shared and stay alive, so its get and
+			   put completions could still arrive */
+			cancel_chan_requests(sp, ch);
+		}
 	}
+	epicsMutexUnlock(sp->lock);
 
-	if (pvName[0] == 0)	/* new name is empty -> free resources */
+	for (n = 0; n < num; n++)
 	{
-		if (dbch)
-		{
-			free(dbch);
-		}
+		if (op[n].shared)
+			op[n].status = seqShareDestroy(op[n].ch, op[n].dbch);
 	}
-	else		/* new name is non-empty -> create resources */
+
+	/* Rename or free the old db channels, allocate new ones */
+	epicsMutexMustLock(sp->lock);
+	for (n = 0; n < num; n++)
 	{
-		if (!dbch)
+		CHAN	*ch = op[n].ch;
+		DBCHAN	*dbch = op[n].dbch;
+
+		if (!op[n].changed)
+			continue;
+		if (op[n].shared)
 		{
-			dbch = new(DBCHAN);
-			if (!dbch)
+			sp->assignCount--;
+
+			if (dbch->gotMonitor)	/* see seq_camonitor */
+			{
+				dbch->gotMonitor = FALSE;
+				sp->gotMonitorCount--;
+			}
+
+			if (dbch->connected)	/* see connection handler */
 			{
-				errlogSevPrintf(errlogFatal, "pvAssign: calloc failed\n");
-				epicsMutexUnlock(sp->lock);
-				return pvStatERROR;
+				dbch->connected = FALSE;
+				sp->connectCount--;
+
+				/* Must not call seq_camonitor(ch, FALSE), it would give
+				an error because channel is already gone. seqShareDestroy
+				takes care of our share in the monitor subscription. */
+
+				/* Note ch->monitored remains on because it is a
+				configuration value that belongs to the variable and newly
+				created channels for the same variable should inherit this
+				configuration. */
 			}
 		}
-		dbch->dbName = epicsStrDup(pvName);
-		if (!dbch->dbName)
+
+		if (op[n].pvName[0] == 0)	/* new name is empty -> free resources */
 		{
-			errlogSevPrintf(errlogFatal, "pvAssign: epicsStrDup failed\n");
-			free(dbch);
-			epicsMutexUnlock(sp->lock);
-			return pvStatERROR;
+			if (dbch)
+				seq_dbch_free(sp, dbch);
 		}
-		ch->dbch = dbch;
-
-		status = pvVarCreate(
-			sp->pvSys,		/* PV system context */
-			dbch->dbName,		/* DB channel name */
-			seq_conn_handler,	/* connection handler routine */
-			seq_event_handler,	/* event handler routine */
-			ch,			/* user ptr is CHAN structure */
-			&dbch->pvid);		/* ptr to pvid */
-		if (status != pvStatOK)
+		else		/* new name is non-empty -> create resources */
 		{
-			errlogSevPrintf(errlogFatal, "pvAssign(var %s, pv %s): pvVarCreate() failure: "
-				"%s\n", ch->varName, dbch->dbName, pvVarGetMess(dbch->pvid));
-			free(ch->dbch->dbName);
-			free(ch->dbch);
+			if (dbch && !seq_dbch_set_name(dbch, op[n].pvName))
+			{
+				seq_dbch_free(sp, dbch);
+				dbch = 0;
+			}
+			else if (!dbch)
+			{
+				dbch = seq_dbch_new(sp, op[n].pvName);
+			}
+			if (!dbch)
+			{
+				errlogSevPrintf(errlogFatal, "pvAssign: out of memory\n");
+				op[n].status = pvStatERROR;
+			}
+			else
+			{
+				ch->dbch = dbch;
+				sp->assignCount++;
+				op[n].create = TRUE;
+			}
 		}
-		else
+		seq_chan_set_size(ch);
+	}
+	epicsMutexUnlock(sp->lock);
+
+	/* seqShareCreate may call the connection handler for the channel */
+	for (n = 0; n < num; n++)
+	{
+		if (op[n].create)
+			op[n].status = seqShareCreate(op[n].ch);
+	}
+
+	epicsMutexMustLock(sp->lock);
+	for (n = 0; n < num; n++)
+	{
+		CHAN *ch = op[n].ch;
+
+		if (op[n].create && op[n].status != pvStatOK)
 		{
-			sp->assignCount++;
+			sp->assignCount--;
+			seq_dbch_free(sp, ch->dbch);
+			ch->dbch = 0;
+			seq_chan_set_size(ch);
 		}
+		if (status == pvStatOK)
+			status = op[n].status;
 	}
-
 	epicsMutexUnlock(sp->lock);
 
 	return status;
@@ -801,11 +1291,24 @@ static pvStat seq_pvSingleMonitor(SS_ID ss, CH_ID chId, boolean turn_on, const c
 			return pvStatERROR;
 		}
 	}
+	if (dbch->lazy)
+	{
+		if (!turn_on)
+		{
+			ch->monitored = FALSE;
+			return pvStatOK;
+		}
+		if (seq_connect_lazy(ch))
+			pvSysFlush(sp->pvSys);
+		dbch = ch->dbch;
+		if (!dbch)
+			return pvStatERROR;
+	}
 	ch->monitored = turn_on;
 	status = seq_camonitor(ch, turn_on);
 	if (status != pvStatOK)
 	{
-		pv_call_failure(dbch, metaPtr(ch,ss), status);
+		pv_call_failure(dbch, seq_ss_meta(ss,ch), status);
 	}
 	return status;
 }
@@ -952,30 +1455,61 @@ epicsShareFunc void seq_pvFlush(SS_ID ss)
 /*
  * Return whether channel is connected.
  */
-epicsShareFunc boolean seq_pvConnected(SS_ID ss, CH_ID chId)
+static boolean pv_connected(SS_ID ss, CH_ID chId, boolean safe)
 {
 	CHAN *ch = ss->prog->chan + chId;
-	if (ss->prog->options & OPT_SAFE)
+	if (safe)
 		return !(ch->dbch) || ch->dbch->connected;
 	else
 		return ch->dbch && ch->dbch->connected;
 }
 
+epicsShareFunc boolean seq_pvConnected(SS_ID ss, CH_ID chId)
+{
+	return pv_connected(ss, chId, optTest(ss->prog, OPT_SAFE));
+}
+
+epicsShareFunc boolean seq_pvConnectedSafe(SS_ID ss, CH_ID chId)
+{
+	return pv_connected(ss, chId, TRUE);
+}
+
+epicsShareFunc boolean seq_pvConnectedTrad(SS_ID ss, CH_ID chId)
+{
+	return pv_connected(ss, chId, FALSE);
+}
+
 /*
  * Return whether elements of a channel array are connected.
  */
-epicsShareFunc boolean seq_pvArrayConnected(SS_ID ss, CH_ID chId, unsigned length)
+static boolean pv_array_connected(SS_ID ss, CH_ID chId, unsigned length,
+	boolean safe)
 {
 	unsigned n;
 
 	for (n=0; n<length; n++)
 	{
-		if (!seq_pvConnected(ss, chId+n))
+		if (!pv_connected(ss, chId+n, safe))
 			return FALSE;
 	}
 	return TRUE;
 }
 
+epicsShareFunc boolean seq_pvArrayConnected(SS_ID ss, CH_ID chId, unsigned length)
+{
+	return pv_array_connected(ss, chId, length, optTest(ss->prog, OPT_SAFE));
+}
+
+epicsShareFunc boolean seq_pvArrayConnectedSafe(SS_ID ss, CH_ID chId, unsigned length)
+{
+	return pv_array_connected(ss, chId, length, TRUE);
+}
+
+epicsShareFunc boolean seq_pvArrayConnectedTrad(SS_ID ss, CH_ID chId, unsigned length)
+{
+	return pv_array_connected(ss, chId, length, FALSE);
+}
+
 /*
  * Return whether channel is assigned.
  */
@@ -1009,7 +1543,7 @@ epicsShareFunc char *seq_pvName(SS_ID ss, CH_ID chId)
 epicsShareFunc pvStat seq_pvStatus(SS_ID ss, CH_ID chId)
 {
 	CHAN	*ch = ss->prog->chan + chId;
-	PVMETA	*meta = metaPtr(ch,ss);
+	PVMETA	*meta = seq_ss_meta(ss,ch);
 	return ch->dbch ? meta->status : pvStatOK;
 }
 
@@ -1019,7 +1553,7 @@ epicsShareFunc pvStat seq_pvStatus(SS_ID ss, CH_ID chId)
 epicsShareFunc pvSevr seq_pvSeverity(SS_ID ss, CH_ID chId)
 {
 	CHAN	*ch = ss->prog->chan + chId;
-	PVMETA	*meta = metaPtr(ch,ss);
+	PVMETA	*meta = seq_ss_meta(ss,ch);
 	return ch->dbch ? meta->severity : pvSevrOK;
 }
 
@@ -1029,7 +1563,7 @@ epicsShareFunc pvSevr seq_pvSeverity(SS_ID ss, CH_ID chId)
 epicsShareFunc const char *seq_pvMessage(SS_ID ss, CH_ID chId)
 {
 	CHAN	*ch = ss->prog->chan + chId;
-	PVMETA	*meta = metaPtr(ch,ss);
+	PVMETA	*meta = seq_ss_meta(ss,ch);
 	return ch->dbch ? meta->message : "";
 }
 
@@ -1039,7 +1573,7 @@ epicsShareFunc const char *seq_pvMessage(SS_ID ss, CH_ID chId)
 epicsShareFunc epicsTimeStamp seq_pvTimeStamp(SS_ID ss, CH_ID chId)
 {
 	CHAN	*ch = ss->prog->chan + chId;
-	PVMETA	*meta = metaPtr(ch,ss);
+	PVMETA	*meta = seq_ss_meta(ss,ch);
 	if (ch->dbch)
 	{
 		return meta->timeStamp;
@@ -1089,23 +1623,38 @@ epicsShareFunc void seq_efInit(PROG_ID sp, EF_ID ev_flag, unsigned val)
 	epicsMutexUnlock(sp->lock);
 }
 
+/*
+ * Whether testing an event flag must refresh channels synced to it
+ * (safe mode only). Reading the list head without taking the lock is
+ * fine: a concurrent pvSync can as well be regarded as coming later.
+ */
+#define mustRefresh(sp, safe, ev_flag) ((safe) && (sp)->syncedChans[ev_flag])
+
 /*
  * Return whether event flag is set.
  */
-epicsShareFunc boolean seq_efTest(SS_ID ss, EF_ID ev_flag)
-/* event flag */
+static boolean ef_test(SS_ID ss, EF_ID ev_flag, boolean safe)
 {
 	PROG	*sp = ss->prog;
 	boolean	isSet;
 
 	assert(ev_flag > 0 && ev_flag <= ss->prog->numEvFlags);
+
+	/* Fast path: a flag that is not set can be reported without taking
+	   the lock; this is the same as if the test happened before a
+	   concurrent efSet. A set flag is tested again under the lock, so
+	   that whatever the setter wrote before setting it is visible to
+	   the caller when we return TRUE. */
+	if (!mustRefresh(sp, safe, ev_flag) && !bitTest(sp->evFlags, ev_flag))
+		return FALSE;
+
 	epicsMutexMustLock(sp->lock);
 
 	isSet = bitTest(sp->evFlags, ev_flag);
 
 	DEBUG("efTest: ev_flag=%d, isSet=%d\n", ev_flag, isSet);
 
-	if (optTest(sp, OPT_SAFE))
+	if (safe)
 		ss_read_buffer_selective(sp, ss, ev_flag);
 
 	epicsMutexUnlock(sp->lock);
@@ -1113,6 +1662,21 @@ epicsShareFunc boolean seq_efTest(SS_ID ss, EF_ID ev_flag)
 	return isSet;
 }
 
+epicsShareFunc boolean seq_efTest(SS_ID ss, EF_ID ev_flag)
+{
+	return ef_test(ss, ev_flag, optTest(ss->prog, OPT_SAFE));
+}
+
+epicsShareFunc boolean seq_efTestSafe(SS_ID ss, EF_ID ev_flag)
+{
+	return ef_test(ss, ev_flag, TRUE);
+}
+
+epicsShareFunc boolean seq_efTestTrad(SS_ID ss, EF_ID ev_flag)
+{
+	return ef_test(ss, ev_flag, FALSE);
+}
+
 /*
  * Clear event flag.
  */
@@ -1139,12 +1703,18 @@ epicsShareFunc boolean seq_efClear(SS_ID ss, EF_ID ev_flag)
  * Atomically test event flag against outstanding events, then clear it
  * and return whether it was set.
  */
-epicsShareFunc boolean seq_efTestAndClear(SS_ID ss, EF_ID ev_flag)
+static boolean ef_test_and_clear(SS_ID ss, EF_ID ev_flag, boolean safe)
 {
 	PROG	*sp = ss->prog;
 	boolean	isSet;
 
 	assert(ev_flag > 0 && ev_flag <= ss->prog->numEvFlags);
+
+	/* Fast path: a flag that is not set need not be cleared; this is
+	   the same as if the test happened before a concurrent efSet */
+	if (!mustRefresh(sp, safe, ev_flag) && !bitTest(sp->evFlags, ev_flag))
+		return FALSE;
+
 	epicsMutexMustLock(sp->lock);
 
 	isSet = bitTest(sp->evFlags, ev_flag);
@@ -1153,7 +1723,7 @@ epicsShareFunc boolean seq_efTestAndClear(SS_ID ss, EF_ID ev_flag)
 	DEBUG("efTestAndClear: ev_flag=%d, isSet=%d, ss=%d\n", ev_flag, isSet,
 		(int)ssNum(ss));
 
-	if (optTest(sp, OPT_SAFE))
+	if (safe)
 		ss_read_buffer_selective(sp, ss, ev_flag);
 
 	epicsMutexUnlock(sp->lock);
@@ -1161,6 +1731,21 @@ epicsShareFunc boolean seq_efTestAndClear(SS_ID ss, EF_ID ev_flag)
 	return isSet;
 }
 
+epicsShareFunc boolean seq_efTestAndClear(SS_ID ss, EF_ID ev_flag)
+{
+	return ef_test_and_clear(ss, ev_flag, optTest(ss->prog, OPT_SAFE));
+}
+
+epicsShareFunc boolean seq_efTestAndClearSafe(SS_ID ss, EF_ID ev_flag)
+{
+	return ef_test_and_clear(ss, ev_flag, TRUE);
+}
+
+epicsShareFunc boolean seq_efTestAndClearTrad(SS_ID ss, EF_ID ev_flag)
+{
+	return ef_test_and_clear(ss, ev_flag, FALSE);
+}
+
 struct getq_cp_arg {
 	CHAN	*ch;
 	void	*var;
@@ -1185,7 +1770,7 @@ static void *getq_cp(void *dest, const void *value, size_t elemSize)
 		meta->timeStamp = pv_stamp(value,type);
 		count = ch->dbch->dbCount;
 	}
-	return memcpy(var, pv_value_ptr(value,type), ch->type->size * count);
+	return copyValue(var, pv_value_ptr(value,type), ch->type->size * count);
 }
 
 /*
@@ -1197,7 +1782,7 @@ epicsShareFunc boolean seq_pvGetQ(SS_ID ss, CH_ID chId)
 	CHAN	*ch = sp->chan + chId;
 	void	*var = valPtr(ch,ss);
 	EF_ID	ev_flag = ch->syncedTo;
-	PVMETA	*meta = metaPtr(ch,ss);
+	PVMETA	*meta = seq_ss_meta(ss,ch);
 	boolean	was_empty;
 	struct getq_cp_arg arg = {ch, var, meta};
 
@@ -1293,15 +1878,47 @@ epicsShareFunc boolean seq_optGet(SS_ID ss, const char *opt)
 	switch (opt[0])
 	{
 	case 'a': return optTest(sp, OPT_ASYNC);
+	case 'b': return optTest(sp, OPT_COMBINE);
 	case 'c': return optTest(sp, OPT_CONN);
 	case 'd': return optTest(sp, OPT_DEBUG);
 	case 'e': return optTest(sp, OPT_NEWEF);
 	case 'r': return optTest(sp, OPT_REENT);
 	case 's': return optTest(sp, OPT_SAFE);
+	case 'g': return optTest(sp, OPT_CACHEGET);
+	case 'u': return optTest(sp, OPT_AUTOMON);
+	case 'k': return optTest(sp, OPT_BLOCKS);
+	case 'p': return optTest(sp, OPT_PROFILE);
+	case 'z': return optTest(sp, OPT_LAZY);
 	default:  return FALSE;
 	}
 }
 
+/*
+ * Profiling support for code generated with option +p. A profiled
+ * function takes one time stamp when it starts and one more after
+ * each block; seq_profileLap charges the time since the previous
+ * stamp to the block's entry. Entries are updated without locking:
+ * all instances of a program share the table, so with several
+ * instances an occasional update may get lost.
+ */
+epicsShareFunc double seq_profileStart(void)
+{
+	double	now;
+
+	pvTimeGetCurrentDouble(&now);
+	return now;
+}
+
+epicsShareFunc void seq_profileLap(seqProfileEntry *entry, double *lap)
+{
+	double	now;
+
+	pvTimeGetCurrentDouble(&now);
+	entry->count++;
+	entry->time += now - *lap;
+	*lap = now;
+}
+
 /* 
  * Given macro name, return pointer to its value.
  */
@@ -15,7 +15,13 @@ TODO: Get rid of this and use the macLib from EPICS base.
 #include "seq.h"
 #include "seq_debug.h"
 
-/* Macro table */
+/* Size of the macro and expansion hash tables, must be a power of 2 */
+#define MAC_TABLE_SIZE	64
+
+/* Maximum number of cached expansions per program instance */
+#define MAC_CACHE_MAX	256
+
+/* Macro table entry, also used for cached expansions (name=template) */
 struct macro
 {
 	char	*name;
@@ -27,72 +33,145 @@ static unsigned seqMacParseName(const char *str);
 static unsigned seqMacParseValue(const char *str);
 static const char *skipBlanks(const char *pchr);
 static MACRO *seqMacTblGet(PROG *sp, char *name);
+static MACRO *seqMacFind(MACRO **table, const char *name, size_t nameLth);
+static size_t seqMacSubst(PROG *sp, const char *inStr, char *outStr);
 
-/* 
- *seqMacEval - substitute macro value into a string containing:
+/*
+ * seqMacEval - substitute macro values into a string containing:
  * ....{mac_name}....
+ * Returns the expanded string, or NULL if out of memory. It may be the
+ * input string itself if that does not contain any macros.
+ *
+ * If cache is TRUE, the expansion is cached, so that each distinct
+ * string is expanded only once, and the result remains valid until
+ * seqMacFree. The cache is bounded; once it holds MAC_CACHE_MAX entries,
+ * further strings are expanded as if cache were FALSE. Otherwise the
+ * result is allocated for this call only and also returned in *tmp,
+ * which the caller must free after use. *tmp is NULL if nothing needs
+ * to be freed.
  */
-void seqMacEval(PROG *sp, const char *inStr, char *outStr, size_t maxChar)
+const char *seqMacEval(PROG *sp, const char *inStr, boolean cache, char **tmp)
 {
-	char	name[50], *value, *tmp;
-	size_t	valLth, nameLth;
+	MACRO	*exp = NULL;
+	size_t	inLth, outLth;
+	char	*outStr;
 
-	assert(outStr);
-	assert(maxChar > 0);
-
-	DEBUG("seqMacEval: InStr=%s, ", inStr);
+	DEBUG("seqMacEval: InStr=%s\n", inStr);
 
+	*tmp = NULL;
 	if (!inStr)
+		return "";
+	if (!strchr(inStr, '{'))
+		return inStr;
+
+	inLth = strlen(inStr);
+	epicsMutexMustLock(sp->lock);
+	if (cache && !sp->macroCache)
+		sp->macroCache = newArray(MACRO*, MAC_TABLE_SIZE);
+	exp = seqMacFind(sp->macroCache, inStr, inLth);
+	if (exp)
 	{
-		*outStr = 0;
-		return;
+		epicsMutexUnlock(sp->lock);
+		DEBUG("OutStr=%s\n", exp->value);
+		return exp->value;
 	}
 
-	tmp = outStr;
-	while (*inStr != 0 && maxChar > 0)
+	outLth = seqMacSubst(sp, inStr, NULL);
+	outStr = newArray(char, outLth+1);
+	if (!outStr)
+	{
+		epicsMutexUnlock(sp->lock);
+		return NULL;
+	}
+	seqMacSubst(sp, inStr, outStr);
+
+	if (cache && sp->macroCache && sp->numCached < MAC_CACHE_MAX
+		&& (exp = new(MACRO)) && (exp->name = epicsStrDup(inStr)))
+	{
+		MACRO **head = sp->macroCache
+			+ (epicsMemHash(inStr, inLth, 0) & (MAC_TABLE_SIZE-1));
+
+		exp->value = outStr;
+		exp->next = *head;
+		*head = exp;
+		sp->numCached++;
+	}
+	else
+	{
+		/* not cached, the caller owns the result */
+		free(exp);
+		*tmp = outStr;
+	}
+	epicsMutexUnlock(sp->lock);
+
+	DEBUG("OutStr=%s\n", outStr);
+	return outStr;
+}
+
+/*
+ * seqMacSubst - do the actual macro substitution. If outStr is NULL,
+ * only compute the length of the result. Returns the length of the
+ * result (excluding the terminating zero).
+ */
+static size_t seqMacSubst(PROG *sp, const char *inStr, char *outStr)
+{
+	size_t	outLth = 0;
+
+	while (*inStr != 0)
 	{
 		if (*inStr == '{')
 		{	/* Do macro substitution */
-			inStr++; /* points to macro name */
-			/* Copy the macro name */
-			nameLth = 0;
+			const char	*name = ++inStr;	/* macro name */
+			size_t		nameLth;
+			MACRO		*mac;
+
 			while (*inStr != '}' && *inStr != 0)
-			{
-				name[nameLth] = *inStr++;
-				if (nameLth < (sizeof(name) - 1))
-					nameLth++;
-			}
-			name[nameLth] = 0;
+				inStr++;
+			nameLth = (size_t)(inStr - name);
 			if (*inStr != 0)
 				inStr++;
 
-			DEBUG("Macro name=%s, ", name);
-
 			/* Find macro value from macro name */
-			value = seqMacValGet(sp, name);
-			if (value != NULL)
+			mac = seqMacFind(sp->macros, name, nameLth);
+			if (mac && mac->value)
 			{	/* Substitute macro value */
-				valLth = strlen(value);
-				if (valLth > maxChar)
-					valLth = maxChar;
+				size_t valLth = strlen(mac->value);
 
-				DEBUG("Value=%s, ", value);
-
-				strncpy(outStr, value, valLth);
-				maxChar -= valLth;
-				outStr += valLth;
+				if (outStr)
+					memcpy(outStr + outLth, mac->value, valLth);
+				outLth += valLth;
 			}
-			
 		}
 		else
 		{	/* Straight substitution */
-			*outStr++ = *inStr++;
-			maxChar--;
+			if (outStr)
+				outStr[outLth] = *inStr;
+			outLth++;
+			inStr++;
 		}
 	}
-	*outStr = 0;
+	if (outStr)
+		outStr[outLth] = 0;
+	return outLth;
+}
+
+/*
+ * seqMacFind - find the entry with the given name (which need not be
+ * zero terminated) in a hash table.
+ */
+static MACRO *seqMacFind(MACRO **table, const char *name, size_t nameLth)
+{
+	MACRO	*mac;
 
-	DEBUG("OutStr=%s\n", tmp);
+	if (!table)
+		return NULL;
+	foreach(mac, table[epicsMemHash(name, nameLth, 0) & (MAC_TABLE_SIZE-1)])
+	{
+		if (mac->name && strncmp(name, mac->name, nameLth) == 0
+			&& mac->name[nameLth] == 0)
+			return mac;
+	}
+	return NULL;
 }
 
 /*
@@ -103,13 +182,11 @@ char *seqMacValGet(PROG *sp, const char *name)
 	MACRO	*mac;
 
 	DEBUG("seqMacValGet: name=%s", name);
-	foreach(mac, sp->macros)
+	mac = seqMacFind(sp->macros, name, strlen(name));
+	if (mac)
 	{
-		if (mac->name && strcmp(name, mac->name) == 0)
-		{
-			DEBUG(", value=%s\n", mac->value);
-			return mac->value;
-		}
+		DEBUG(", value=%s\n", mac->value);
+		return mac->value;
 	}
 	DEBUG(", no value\n");
 	return NULL;
@@ -154,11 +231,19 @@ void seqMacParse(PROG *sp, const char *macStr)
 		/* Find a slot in the table */
 		mac = seqMacTblGet(sp, name);
 		if (mac == NULL)
-			break;		/* table is full */
+		{
+			errlogSevPrintf(errlogFatal, "seqMacParse: calloc failed\n");
+			free(name);
+			break;
+		}
 		if (mac->name == NULL)
 		{	/* Empty slot, insert macro name */
 			mac->name = name;
 		}
+		else
+		{
+			free(name);
+		}
 
 		/* Skip over blanks and equal sign or comma */
 		macStr = skipBlanks(macStr);
@@ -256,42 +341,61 @@ static const char *skipBlanks(const char *pchr)
  */
 static MACRO *seqMacTblGet(PROG *sp, char *name)
 {
-	MACRO	*mac, *lastMac = NULL;
+	MACRO	*mac, **head;
+	size_t	nameLth = strlen(name);
 
 	DEBUG("seqMacTblGet: name=%s\n", name);
-	foreach(mac, sp->macros)
+	if (!sp->macros)
 	{
-		lastMac = mac;
-		if (mac->name != NULL &&
-			strcmp(name, mac->name) == 0)
-		{
-			return mac;
-		}
+		sp->macros = newArray(MACRO*, MAC_TABLE_SIZE);
+		if (!sp->macros)
+			return NULL;
 	}
+	mac = seqMacFind(sp->macros, name, nameLth);
+	if (mac)
+		return mac;
 	/* Not found, allocate an empty slot */
 	mac = new(MACRO);
-	/* This assumes ptr assignment is atomic */
-	if (lastMac != NULL)
-		lastMac->next = mac;
-	else
-		sp->macros = mac;
+	if (mac)
+	{
+		head = sp->macros + (epicsMemHash(name, nameLth, 0) & (MAC_TABLE_SIZE-1));
+		mac->next = *head;
+		*head = mac;
+	}
 	return mac;
 }
 
+/* Free a macro hash table */
+static void seqMacFreeTable(MACRO **table)
+{
+	unsigned n;
+
+	if (!table)
+		return;
+	for (n = 0; n < MAC_TABLE_SIZE; n++)
+	{
+		MACRO *mac = table[n];
+
+		while (mac)
+		{
+			MACRO *next = mac->next;
+
+			free(mac->name);
+			free(mac->value);
+			free(mac);
+			mac = next;
+		}
+	}
+}
+
 /*
  * seqMacFree - free all the memory
  */
 void seqMacFree(PROG *sp)
 {
-	MACRO	*mac, *lastMac = NULL;
-
-	foreach(mac, sp->macros)
-	{
-		free(mac->name);
-		free(mac->value);
-		free(lastMac);
-		lastMac = mac;
-	}
-	free(lastMac);
-	sp->macros = 0;
+	seqMacFreeTable(sp->macros);
+	free(sp->macros);
+	seqMacFreeTable(sp->macroCache);
+	free(sp->macroCache);
+	sp->numCached = 0;
 }
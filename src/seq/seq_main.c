@@ -11,9 +11,13 @@ in the file LICENSE that is included with this distribution.
 #include "seq.h"
 #include "seq_debug.h"
 
+static PROG *alloc_prog(PROG *proto, seqProgram *seqProg);
+static size_t layout_prog(PROG *sp, seqSS *seqSS, char *base);
 static boolean init_sprog(PROG *sp, seqProgram *seqProg);
 static boolean init_sscb(PROG *sp, SSCB *ss, seqSS *seqSS);
 static boolean init_chan(PROG *sp, CHAN *ch, seqChan *seqChan);
+static boolean waited_for(PROG *sp, CHAN *ch);
+static void init_single_putters(PROG *sp, seqSS *seqSS);
 
 /*
  * types for DB put/get, element size based on user variable type.
@@ -55,7 +59,7 @@ epicsShareFunc epicsThreadId epicsShareAPI seq(
 	seqProgram *seqProg, const char *macroDef, unsigned stackSize)
 {
 	epicsThreadId	tid;
-	PROG		*sp;
+	PROG		proto, *sp = &proto;
 	char		*str;
 	const char	*threadName;
 	unsigned int	smallStack;
@@ -82,12 +86,9 @@ epicsShareFunc epicsThreadId epicsShareAPI seq(
 		return 0;
 	}
 
-	sp = new(PROG);
-	if (!sp)
-	{
-		errlogSevPrintf(errlogFatal, "seq: calloc failed\n");
-		return 0;
-	}
+	/* Program parameters go into a prototype that gets copied
+	   into the arena once we know how large it must be */
+	memset(&proto, 0, sizeof(proto));
 
 	/* Parse the macro definitions from the "program" statement */
 	seqMacParse(sp, seqProg->params);
@@ -95,6 +96,47 @@ epicsShareFunc epicsThreadId epicsShareAPI seq(
 	/* Parse the macro definitions from the command line */
 	seqMacParse(sp, macroDef);
 
+	/* Specify max. number of pending puts per channel and state set */
+	sp->maxPuts = 1;
+	str = seqMacValGet(sp, "maxputs");
+	if (str && str[0] != '\0')
+	{
+		int maxPuts = 0;
+
+		sscanf(str, "%d", &maxPuts);
+		if (maxPuts < 1 || maxPuts > MAX_PUTS)
+			errlogSevPrintf(errlogMinor,
+				"seq: ignoring invalid maxputs=%s (must be between 1 and %d)\n",
+				str, MAX_PUTS);
+		else
+			sp->maxPuts = (unsigned)maxPuts;
+	}
+
+	/* Specify CA priority for channels that don't specify one */
+	sp->caPriority = 0;
+	str = seqMacValGet(sp, "capriority");
+	if (str && str[0] != '\0')
+	{
+		sscanf(str, "%u", &sp->caPriority);
+	}
+
+	/* Specify delay before an automatic monitor is turned off (+u) */
+	sp->monGrace = 5.0;
+	str = seqMacValGet(sp, "mongrace");
+	if (str && str[0] != '\0')
+	{
+		sscanf(str, "%lf", &sp->monGrace);
+	}
+
+	/* Allocate program struct and all its arrays */
+	sp = alloc_prog(&proto, seqProg);
+	if (!sp)
+	{
+		errlogSevPrintf(errlogFatal, "seq: calloc failed\n");
+		seqMacFree(&proto);
+		return 0;
+	}
+
 	/* Initialize program struct */
 	if (!init_sprog(sp, seqProg))
 		return 0;
@@ -144,6 +186,124 @@ epicsShareFunc epicsThreadId epicsShareAPI seq(
 	return tid;
 }
 
+/*
+ * Allocate a program instance and all its arrays in a single arena.
+ * The program parameters are taken from proto.
+ */
+static PROG *alloc_prog(PROG *proto, seqProgram *seqProg)
+{
+	char	*arena, *base;
+	size_t	size;
+	PROG	*sp;
+
+	/* Copy information that determines the sizes */
+	proto->numSS = seqProg->numSS;
+	proto->numChans = seqProg->numChans;
+	proto->numEvFlags = seqProg->numEvFlags;
+	proto->options = seqProg->options;
+	proto->varSize = seqProg->varSize;
+	proto->numQueues = seqProg->numQueues;
+
+	size = layout_prog(proto, seqProg->ss, NULL);
+	arena = newArray(char, size + CACHE_LINE_SIZE - 1);
+	if (!arena)
+		return NULL;
+	base = (char *)(((size_t)arena + CACHE_LINE_SIZE - 1)
+		& ~(size_t)(CACHE_LINE_SIZE - 1));
+	sp = (PROG *)base;
+	*sp = *proto;
+	sp->arena = arena;
+	layout_prog(sp, seqProg->ss, base);
+	return sp;
+}
+
+/*
+ * Reserve size bytes at the next cache line boundary of an arena starting
+ * at base of which *used bytes are already taken. Returns NULL if size is
+ * zero or base is NULL (when only computing the size of the arena).
+ */
+static void *reserve(char *base, size_t *used, size_t size)
+{
+	size_t offset = (*used + CACHE_LINE_SIZE - 1)
+		& ~(size_t)(CACHE_LINE_SIZE - 1);
+
+	*used = offset + size;
+	return base && size ? base + offset : NULL;
+}
+
+/*
+ * Lay out a program instance in an arena starting at base: the program
+ * struct, the state set and channel arrays, program-wide arrays, then for
+ * each state set its request and dirty arrays (touched on every event)
+ * followed by the rest of its data. Each part starts on a new cache line.
+ * The per state set request and meta data arrays have one entry for each
+ * channel the state set uses (as listed by snc) instead of one for each
+ * channel of the program, see seq_ss_slot.
+ * Returns the size of the arena. If base is NULL, sp is only used to
+ * determine the sizes, otherwise pointers in sp are set up.
+ */
+static size_t layout_prog(PROG *sp, seqSS *seqSS, char *base)
+{
+	size_t	used = 0;
+	size_t	nch = sp->numChans;
+	unsigned nss;
+	boolean	safe = optTest(sp, OPT_SAFE);
+	boolean	combine = optTest(sp, OPT_COMBINE);
+	boolean	blocks = optTest(sp, OPT_BLOCKS);
+
+	reserve(base, &used, sizeof(PROG));
+	sp->ss = (SSCB *)reserve(base, &used, sp->numSS * sizeof(SSCB));
+	sp->chanHot = (CHANHOT *)reserve(base, &used, nch * sizeof(CHANHOT));
+	sp->chan = (CHAN *)reserve(base, &used, nch * sizeof(CHAN));
+	/* Note: event flag bits only, not for all event numbers */
+	assert(NWORDS(sp->numEvFlags) > 0);
+	sp->evFlags = (bitMask *)reserve(base, &used,
+		NWORDS(sp->numEvFlags) * sizeof(bitMask));
+	/* NOTE: event flags count from 1 upward */
+	sp->syncedChans = (CHAN **)reserve(base, &used,
+		(sp->numEvFlags + 1) * sizeof(CHAN *));
+	sp->queues = (QUEUE *)reserve(base, &used, sp->numQueues * sizeof(QUEUE));
+	/* User variable area if reentrant option (+r) is set */
+	sp->var = (SEQ_VARS *)reserve(base, &used,
+		optTest(sp, OPT_REENT) ? sp->varSize : 0);
+
+	for (nss = 0; nss < sp->numSS; nss++)
+	{
+		SSCB	dummy, *ss = base ? sp->ss + nss : &dummy;
+		size_t	nslots;
+
+		/* without a list of used channels every channel gets a slot */
+		ss->slotChan = seqSS[nss].chans;
+		ss->numSlots = ss->slotChan ? seqSS[nss].numChans : sp->numChans;
+		nslots = ss->numSlots;
+
+		/* hot */
+		ss->waitMask = (bitMask *)reserve(base, &used,
+			NWORDS(sp->numEvFlags + nch) * sizeof(bitMask));
+		ss->getReq = (PVREQ **)reserve(base, &used,
+			nslots * sizeof(PVREQ *));
+		ss->putReq = (PVREQ **)reserve(base, &used,
+			nslots * sp->maxPuts * sizeof(PVREQ *));
+		ss->dirty = (boolean *)reserve(base, &used,
+			safe ? nslots * sizeof(boolean) : 0);
+		/* cold */
+		ss->metaData = (PVMETA *)reserve(base, &used,
+			safe ? nslots * sizeof(PVMETA) : 0);
+		ss->seen = (unsigned *)reserve(base, &used,
+			safe && blocks ? nslots * sizeof(unsigned) : 0);
+		ss->putBuf = (char **)reserve(base, &used,
+			combine ? nch * sizeof(char *) : 0);
+		ss->staged = (boolean *)reserve(base, &used,
+			combine ? nch * sizeof(boolean) : 0);
+		ss->stagedChans = (unsigned *)reserve(base, &used,
+			combine ? nch * sizeof(unsigned) : 0);
+		/* Separate user variable area if safe mode option (+s) is set */
+		ss->var = safe ? (SEQ_VARS *)reserve(base, &used, sp->varSize)
+			: sp->var;
+	}
+	return used;
+}
+
 /*
  * Copy data from seqCom.h structures into this thread's dynamic structures
  * as defined in seq.h.
@@ -153,27 +313,10 @@ static boolean init_sprog(PROG *sp, seqProgram *seqProg)
 	unsigned nss, nch;
 
 	/* Copy information for state program */
-	sp->numSS = seqProg->numSS;
-	sp->numChans = seqProg->numChans;
-	sp->numEvFlags = seqProg->numEvFlags;
-	sp->options = seqProg->options;
 	sp->progName = seqProg->progName;
 	sp->initFunc = seqProg->initFunc;
 	sp->entryFunc = seqProg->entryFunc;
 	sp->exitFunc = seqProg->exitFunc;
-	sp->varSize = seqProg->varSize;
-	sp->numQueues = seqProg->numQueues;
-
-	/* Allocate user variable area if reentrant option (+r) is set */
-	if (optTest(sp, OPT_REENT) && sp->varSize > 0)
-	{
-		sp->var = (SEQ_VARS *)newArray(char, sp->varSize);
-		if (!sp->var)
-		{
-			errlogSevPrintf(errlogFatal, "init_sprog: calloc failed\n");
-			return FALSE;
-		}
-	}
 
 	DEBUG("init_sprog: numSS=%d, numChans=%d, numEvFlags=%u, "
 		"progName=%s, varSize=%u\n", sp->numSS, sp->numChans,
@@ -199,29 +342,6 @@ static boolean init_sprog(PROG *sp, seqProgram *seqProg)
 		return FALSE;
 	}
 
-	/* Allocate an array for event flag bits. Note this does
-	   *not* reserve space for all event numbers (i.e. including
-	   channels), only for event flags. */
-	assert(NWORDS(sp->numEvFlags) > 0);
-	sp->evFlags = newArray(bitMask, NWORDS(sp->numEvFlags));
-	if (!sp->evFlags)
-	{
-		errlogSevPrintf(errlogFatal, "init_sprog: calloc failed\n");
-		return FALSE;
-	}
-	/* NOTE: event flags count from 1 upward */
-	sp->syncedChans = newArray(CHAN*, sp->numEvFlags+1);
-
-	/* Allocate and initialize syncQ queues */
-	if (sp->numQueues > 0)
-	{
-		sp->queues = newArray(QUEUE, sp->numQueues);
-		if (!sp->queues)
-		{
-			errlogSevPrintf(errlogFatal, "init_sprog: calloc failed\n");
-			return FALSE;
-		}
-	}
 	/* Initial pool for pv requests is 1kB on 32-bit systems */
 	freeListInitPvt(&sp->pvReqPool, 128, sizeof(PVREQ));
 	if (!sp->pvReqPool)
@@ -229,38 +349,28 @@ static boolean init_sprog(PROG *sp, seqProgram *seqProg)
 		errlogSevPrintf(errlogFatal, "init_sprog: freeListInitPvt failed\n");
 		return FALSE;
 	}
-
-	/* Allocate array of state set structs and initialize it */
-	if (sp->numSS > 0)
+	/* Db channels are recycled by pvAssign */
+	freeListInitPvt(&sp->dbchPool, sizeof(DBCHAN), 64);
+	if (!sp->dbchPool)
 	{
-		sp->ss = newArray(SSCB, sp->numSS);
-		if (!sp->ss)
-		{
-			errlogSevPrintf(errlogFatal, "init_sprog: calloc failed\n");
-			return FALSE;
-		}
+		errlogSevPrintf(errlogFatal, "init_sprog: freeListInitPvt failed\n");
+		return FALSE;
 	}
+
+	/* Initialize state set structs */
 	for (nss = 0; nss < sp->numSS; nss++)
 	{
 		if (!init_sscb(sp, sp->ss + nss, seqProg->ss + nss))
 			return FALSE;
 	}
 
-	/* Allocate array of channel structs and initialize it */
-	if (sp->numChans > 0)
-	{
-		sp->chan = newArray(CHAN, sp->numChans);
-		if (!sp->chan)
-		{
-			errlogSevPrintf(errlogFatal, "init_sprog: calloc failed\n");
-			return FALSE;
-		}
-	}
+	/* Initialize channel structs */
 	for (nch = 0; nch < sp->numChans; nch++)
 	{
 		if (!init_chan(sp, sp->chan + nch, seqProg->chan + nch))
 			return FALSE;
 	}
+	init_single_putters(sp, seqProg->ss);
 	return TRUE;
 }
 
@@ -269,9 +379,12 @@ static boolean init_sprog(PROG *sp, seqProgram *seqProg)
  */
 static boolean init_sscb(PROG *sp, SSCB *ss, seqSS *seqSS)
 {
+	unsigned nst, n;
+
 	/* Fill in SSCB */
 	ss->ssName = seqSS->ssName;
 	ss->numStates = seqSS->numStates;
+	ss->readMask = seqSS->readMask;
 
 	ss->currentState = 0; /* initial state */
 	ss->nextState = 0;
@@ -288,31 +401,9 @@ static boolean init_sscb(PROG *sp, SSCB *ss, seqSS *seqSS)
 		return FALSE;
 	}
 
-	if (sp->numChans > 0)
-	{
-		ss->getReq = newArray(PVREQ*, sp->numChans);
-		if (!ss->getReq)
-		{
-			errlogSevPrintf(errlogFatal, "init_sscb: calloc failed\n");
-			return FALSE;
-		}
-		ss->putReq = newArray(PVREQ*, sp->numChans);
-		if (!ss->putReq)
-		{
-			errlogSevPrintf(errlogFatal, "init_sscb: calloc failed\n");
-			return FALSE;
-		}
-		if (optTest(sp, OPT_SAFE))
-		{
-			ss->metaData = newArray(PVMETA, sp->numChans);
-			if (!ss->metaData)
-			{
-				errlogSevPrintf(errlogFatal, "init_ss: calloc failed\n");
-				return FALSE;
-			}
-		}
-	}
-	/* note: do not pre-allocate request structures */
+	/* note: arrays are in the arena (see layout_prog), put buffers
+	   (+b) are allocated on first use, and request structures are
+	   not pre-allocated */
 	ss->dead = epicsEventCreate(epicsEventEmpty);
 	if (!ss->dead)
 	{
@@ -324,33 +415,13 @@ static boolean init_sscb(PROG *sp, SSCB *ss, seqSS *seqSS)
 	   because nothing gets mutated. */
 	ss->states = seqSS->states;
 
-	/* Allocate separate user variable area if safe mode option (+s) is set */
-	if (optTest(sp, OPT_SAFE))
-	{
-		if (sp->numChans > 0)
-		{
-			ss->dirty = newArray(boolean, sp->numChans);
-			if (!ss->dirty)
-			{
-				errlogSevPrintf(errlogFatal, "init_sscb: calloc failed\n");
-				return FALSE;
-			}
-		}
-		if (sp->varSize > 0)
-		{
-			ss->var = (SEQ_VARS *)newArray(char, sp->varSize);
-			if (!ss->var)
-			{
-				errlogSevPrintf(errlogFatal, "init_sscb: calloc failed\n");
-				return FALSE;
-			}
-		}
-	}
-	else
+	/* Which events any state waits for, see ss_wakeup */
+	for (nst = 0; nst < ss->numStates; nst++)
 	{
-		ss->dirty = NULL;
-		ss->var = sp->var;
+		for (n = 0; n < NWORDS(sp->numEvFlags + sp->numChans); n++)
+			ss->waitMask[n] |= ss->states[nst].eventMask[n];
 	}
+
 	return TRUE;
 }
 
@@ -362,7 +433,7 @@ static boolean init_chan(PROG *sp, CHAN *ch, seqChan *seqChan)
 	DEBUG("init_chan: ch=%p\n", ch);
 	ch->prog = sp;
 	ch->varName = seqChan->varName;
-	ch->offset = seqChan->offset;
+	chHot(ch)->offset = seqChan->offset;
 	ch->count = seqChan->count;
 	if (ch->count == 0) ch->count = 1;
 	ch->syncedTo = seqChan->efId;
@@ -374,52 +445,67 @@ static boolean init_chan(PROG *sp, CHAN *ch, seqChan *seqChan)
 		ch->nextSynced = fst;
 	}
 	ch->monitored = seqChan->monitored;
-	ch->eventNum = seqChan->eventNum;
+	chHot(ch)->eventNum = seqChan->eventNum;
+	ch->priority = seqChan->priority >= 0 ? (unsigned)seqChan->priority
+		: sp->caPriority;
+	/* Monitor follows the states that wait for the channel (+u) */
+	if (optTest(sp, OPT_AUTOMON) && ch->monitored)
+		ch->autoMon = waited_for(sp, ch);
 
 	/* Fill in request type info */
 	ch->type = pv_type_map + seqChan->varType;
 	assert(seqChan->varType == ch->type->tag);
 
 	DEBUG("  varname=%s, count=%u\n"
-		"  syncedTo=%u, monitored=%u, eventNum=%u\n",
+		"  syncedTo=%u, monitored=%u, eventNum=%u, priority=%u\n",
 		ch->varName, ch->count,
-		ch->syncedTo, ch->monitored, ch->eventNum);
+		ch->syncedTo, ch->monitored, chHot(ch)->eventNum, ch->priority);
 	DEBUG("  type=%p: tag=%s, putType=%d, getType=%d, size=%d\n",
 		ch->type, prim_type_tag_name[ch->type->tag],
 		ch->type->putType, ch->type->getType, ch->type->size);
 
 	if (seqChan->chName)	/* skip anonymous PVs */
 	{
-		char name_buffer[100];
+		/* each name is expanded only once, so don't cache it */
+		char	*tmp;
+		const char *name = seqMacEval(sp, seqChan->chName, FALSE, &tmp);
 
-		seqMacEval(sp, seqChan->chName, name_buffer, sizeof(name_buffer));
-		if (name_buffer[0])	/* skip anonymous PVs */
+		if (!name)
 		{
-			DBCHAN	*dbch = new(DBCHAN);
+			errlogSevPrintf(errlogFatal, "init_chan: out of memory\n");
+			return FALSE;
+		}
+		if (name[0])	/* skip anonymous PVs */
+		{
+			DBCHAN	*dbch = seq_dbch_new(sp, name);
+
 			if (!dbch)
 			{
-				errlogSevPrintf(errlogFatal, "init_chan: calloc failed\n");
-				return FALSE;
-			}
-			dbch->dbName = epicsStrDup(name_buffer);
-			if (!dbch->dbName)
-			{
-				errlogSevPrintf(errlogFatal, "init_chan: epicsStrDup failed\n");
+				errlogSevPrintf(errlogFatal, "init_chan: out of memory\n");
+				free(tmp);
 				return FALSE;
 			}
 			ch->dbch = dbch;
 			sp->assignCount++;
-			if (ch->monitored)
+			if (optTest(sp, OPT_LAZY))
+			{
+				/* connect on first use, see seq_connect_lazy */
+				dbch->lazy = TRUE;
+				sp->lazyCount++;
+			}
+			else if (ch->monitored)
 				sp->monitorCount++;
 			DEBUG("  assigned name=%s, expanded name=%s\n",
 				seqChan->chName, ch->dbch->dbName);
 		}
+		free(tmp);
 	}
 
 	if (!ch->dbch)
 	{
 		DEBUG("  pv name=<anonymous>\n");
 	}
+	seq_chan_set_size(ch);
 
 	if (seqChan->queueSize)
 	{
@@ -461,10 +547,63 @@ static boolean init_chan(PROG *sp, CHAN *ch, seqChan *seqChan)
 	return TRUE;
 }
 
+/*
+ * Find the anonymous queued channels whose queue only a single state set
+ * passes to pvPut, according to the put masks generated by snc. A queue
+ * allows one writer and one reader without a lock, so pvPut does not have
+ * to take the channel's varLock for these.
+ */
+static void init_single_putters(PROG *sp, seqSS *seqSS)
+{
+	unsigned nch, other, nss;
+
+	for (nch = 0; nch < sp->numChans; nch++)
+	{
+		CHAN	*ch = sp->chan + nch;
+		unsigned putters = 0;
+
+		if (!ch->queue || ch->dbch)
+			continue;
+		for (nss = 0; nss < sp->numSS; nss++)
+		{
+			const seqMask *putMask = seqSS[nss].putMask;
+			boolean	puts = !putMask;
+
+			for (other = 0; !puts && other < sp->numChans; other++)
+				puts = sp->chan[other].queue == ch->queue
+					&& bitTest(putMask, other);
+			if (puts)
+				putters++;
+		}
+		ch->singlePutter = putters <= 1;
+	}
+}
+
+/*
+ * Whether any state of the program waits for the channel.
+ */
+static boolean waited_for(PROG *sp, CHAN *ch)
+{
+	unsigned nss, nst;
+
+	for (nss = 0; nss < sp->numSS; nss++)
+	{
+		SSCB *ss = sp->ss + nss;
+
+		for (nst = 0; nst < ss->numStates; nst++)
+		{
+			if (waitsFor(ss->states[nst].eventMask, ch))
+				return TRUE;
+		}
+	}
+	return FALSE;
+}
+
 /* Free all allocated memory in a program structure */
 void seq_free(PROG *sp)
 {
 	unsigned nss, nch, nq;
+	void	*arena = sp->arena;
 
 	/* Delete state sets */
 	for (nss = 0; nss < sp->numSS; nss++)
@@ -472,16 +611,15 @@ void seq_free(PROG *sp)
 		SSCB *ss = sp->ss + nss;
 
 		epicsEventDestroy(ss->syncSem);
-		free(ss->metaData);
-
 		epicsEventDestroy(ss->dead);
 
-		if (optTest(sp, OPT_SAFE)) free(ss->dirty);
-		if (optTest(sp, OPT_SAFE)) free(ss->var);
+		if (ss->putBuf)
+		{
+			for (nch = 0; nch < sp->numChans; nch++)
+				free(ss->putBuf[nch]);
+		}
 	}
 
-	free(sp->ss);
-
 	/* Delete program-wide semaphores */
 	epicsMutexDestroy(sp->lock);
 	epicsEventDestroy(sp->ready);
@@ -493,19 +631,17 @@ void seq_free(PROG *sp)
 		CHAN *ch = sp->chan + nch;
 
 		if (ch->dbch)
-		{
-			free(ch->dbch->dbName);
-			free(ch->dbch);
-		}
+			seq_dbch_free(sp, ch->dbch);
+		if (ch->varLock)
+			epicsMutexDestroy(ch->varLock);
 	}
-	free(sp->chan);
+	if (sp->dbchPool)
+		freeListCleanup(sp->dbchPool);
+	ss_free_snapshots(sp);
 
 	for (nq = 0; nq < sp->numQueues; nq++)
 		seqQueueDestroy(sp->queues[nq]);
-	free(sp->queues);
 
-	free(sp->evFlags);
-	free(sp->syncedChans);
-	if (optTest(sp, OPT_REENT)) free(sp->var);
-	free(sp);
+	/* Everything else is in the arena, including sp itself */
+	free(arena);
 }
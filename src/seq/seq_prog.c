@@ -13,36 +13,73 @@ in the file LICENSE that is included with this distribution.
 #include "seq.h"
 #include "seq_debug.h"
 
-/*
- * seqFindProg() - find a program in the state program list from thread id.
- */
-PROG *seqFindProg(epicsThreadId threadId)
+/* Size of the thread id index, must be a power of 2 */
+#define THREAD_HASH_SIZE 256
+
+/* Index of all registered state sets by thread id */
+static struct {
+    epicsMutexId lock;
+    SSCB *table[THREAD_HASH_SIZE];
+} threads;
+
+static void threadIndexInit(void *arg)
 {
-    SSCB *ss = seqFindStateSet(threadId);
-    return ss ? ss->prog : NULL;
+    threads.lock = epicsMutexCreate();
+    if (!threads.lock) {
+        errlogSevPrintf(errlogFatal, "threadIndexInit: epicsMutexCreate failed\n");
+        exit(EXIT_FAILURE);
+    }
 }
 
-struct findStateSetArgs {
-    SSCB *ss;
-    epicsThreadId threadId;
-};
+static SSCB **threadBucket(epicsThreadId threadId)
+{
+    static epicsThreadOnceId threadsOnceFlag = EPICS_THREAD_ONCE_INIT;
+
+    epicsThreadOnce(&threadsOnceFlag, threadIndexInit, NULL);
+    return threads.table + (epicsMemHash((const char *)&threadId,
+        sizeof(threadId), 0) & (THREAD_HASH_SIZE-1));
+}
 
-static int findStateSet(PROG *sp, void *param)
+/*
+ * seqAddStateSet() - add a state set to the thread id index.
+ * Must be called after its threadId has been set.
+ */
+void seqAddStateSet(SSCB *ss)
 {
-    struct findStateSetArgs *pargs = (struct findStateSetArgs *)param;
-    unsigned nss;
+    SSCB **head = threadBucket(ss->threadId);
 
-    for (nss = 0; nss < sp->numSS; nss++) {
-        SSCB *ss = sp->ss + nss;
+    epicsMutexMustLock(threads.lock);
+    ss->nextByThread = *head;
+    *head = ss;
+    epicsMutexUnlock(threads.lock);
+}
 
-        DEBUG("findStateSet trying %s[%d] ss[%d].threadId=%p\n",
-            sp->progName, sp->instance, nss, ss->threadId);
-        if (ss->threadId == pargs->threadId) {
-            pargs->ss = ss;
-            return TRUE;
+/* Remove a state set from the thread id index */
+static void delStateSet(SSCB *ss)
+{
+    SSCB **pss;
+
+    if (!ss->threadId)
+        return;
+    pss = threadBucket(ss->threadId);
+    epicsMutexMustLock(threads.lock);
+    for (; *pss; pss = &(*pss)->nextByThread) {
+        if (*pss == ss) {
+            *pss = ss->nextByThread;
+            break;
         }
     }
-    return FALSE;
+    epicsMutexUnlock(threads.lock);
+    ss->nextByThread = NULL;
+}
+
+/*
+ * seqFindProg() - find a program in the state program list from thread id.
+ */
+PROG *seqFindProg(epicsThreadId threadId)
+{
+    SSCB *ss = seqFindStateSet(threadId);
+    return ss ? ss->prog : NULL;
 }
 
 /*
@@ -50,12 +87,18 @@ static int findStateSet(PROG *sp, void *param)
  */
 SSCB *seqFindStateSet(epicsThreadId threadId)
 {
-    struct findStateSetArgs args;
+    SSCB **head = threadBucket(threadId);
+    SSCB *ss;
 
-    args.ss = 0;
-    args.threadId = threadId;
-    seqTraverseProg(findStateSet, &args);
-    return args.ss;
+    epicsMutexMustLock(threads.lock);
+    for (ss = *head; ss; ss = ss->nextByThread) {
+        DEBUG("seqFindStateSet trying %s[%d] %s threadId=%p\n",
+            ss->prog->progName, ss->prog->instance, ss->ssName, ss->threadId);
+        if (ss->threadId == threadId)
+            break;
+    }
+    epicsMutexUnlock(threads.lock);
+    return ss;
 }
 
 struct traverseInstancesArgs {
@@ -121,12 +164,14 @@ static int addProg(PROG **ppInstances, seqProgram *pseq, void *param)
 }
 
 /*
- * seqAddProg() - add a program to the program instance list.
+ * seqAddProg() - add a program to the program instance list and
+ * its first state set to the thread id index.
  * Precondition: must not be already in the list.
  */
 void seqAddProg(PROG *sp)
 {
-    traverseSequencerPrograms(addProg, sp);
+    visitSequencerProgram(sp->progName, addProg, sp);
+    seqAddStateSet(sp->ss);
 }
 
 static int delProg(PROG **ppInstances, seqProgram *pseq, void *param)
@@ -155,9 +200,14 @@ static int delProg(PROG **ppInstances, seqProgram *pseq, void *param)
 }
 
 /*
- * seqDelProg() - delete a program from the program instance list.
+ * seqDelProg() - delete a program from the program instance list
+ * and its state sets from the thread id index.
  */
 void seqDelProg(PROG *sp)
 {
-    traverseSequencerPrograms(delProg, sp);
+    unsigned nss;
+
+    for (nss = 0; nss < sp->numSS; nss++)
+        delStateSet(sp->ss + nss);
+    visitSequencerProgram(sp->progName, delProg, sp);
 }
@@ -12,6 +12,7 @@ in the file LICENSE that is included with this distribution.
 \*************************************************************************/
 #include "seq.h"
 #include "seqStats.h"
+#include "seq_debug.h"
 
 static int userInput(void);
 static void printValue(pr_fun *pr, void *val, unsigned count, int type);
@@ -50,11 +51,30 @@ epicsShareFunc void epicsShareAPI seqShow(epicsThreadId tid)
 	/* Note: need not take lock since read-ony */
 	printf("  number of channels assigned = %d\n", sp->assignCount);
 	printf("  number of channels connected = %d\n", sp->connectCount);
+	if (optTest(sp, OPT_LAZY))
+		printf("  number of channels not yet used = %u\n", sp->lazyCount);
 	printf("  number of channels monitored = %d\n", sp->monitorCount);
-	printf("  options: async=%d, debug=%d, newef=%d, reent=%d, conn=%d\n",
+	printf("  number of gets served from monitors = %u\n", sp->cachedGetCount);
+	if (sp->connRampSteps > 0)
+	{
+		static const char *step[] = {"50%", "90%", "100%"};
+		unsigned n;
+
+		printf("  connection ramp:");
+		for (n = 0; n < sp->connRampSteps; n++)
+			printf(" %s after %.3f s%s", step[n], sp->connRamp[n],
+				n + 1 < sp->connRampSteps ? "," : "");
+		printf("\n");
+	}
+	printf("  options: async=%d, debug=%d, newef=%d, reent=%d, conn=%d, "
+		"cacheget=%d, combine=%d, lazy=%d, automon=%d, blocks=%d, "
+		"profile=%d\n",
 		optTest(sp, OPT_ASYNC), optTest(sp, OPT_DEBUG),
 		optTest(sp, OPT_NEWEF), optTest(sp, OPT_REENT),
-		optTest(sp, OPT_CONN));
+		optTest(sp, OPT_CONN), optTest(sp, OPT_CACHEGET),
+		optTest(sp, OPT_COMBINE), optTest(sp, OPT_LAZY),
+		optTest(sp, OPT_AUTOMON), optTest(sp, OPT_BLOCKS),
+		optTest(sp, OPT_PROFILE));
 	if (optTest(sp, OPT_REENT))
 		printf("  user variables: address = %p, length = %u\n",
 			sp->var, (unsigned)sp->varSize);
@@ -105,6 +125,9 @@ epicsShareFunc void epicsShareAPI seqShow(epicsThreadId tid)
 				printf("%d",!seq_pvPutComplete(ss, n, 1, 0, 0));
 		printf("]\n");
 
+		if (optTest(sp, OPT_COMBINE))
+			printf("  Combined puts = %u\n", ss->combinedPuts);
+
 		if (optTest(sp, OPT_SAFE))
 			printf("  User variables: address = %p, length = %u\n",
 				sp->var, (unsigned)sp->varSize);
@@ -177,7 +200,16 @@ epicsShareFunc void epicsShareAPI seqChanShow(epicsThreadId tid, const char *str
 		printValue(printf, valPtr(ch,ss), ch->count, ch->type->putType);
 
 		if (dbch)
+		{
 			printf("  Assigned to \"%s\"\n", dbch->dbName);
+			if (dbch->lazy)
+				printf("  Not yet used\n");
+			else
+				printf("  Shared by %u channel(s)\n", seqShareCount(ch));
+		}
+		else if (ch->queue)
+			printf("  Anonymous, queue written by %s\n", ch->singlePutter ?
+				"a single state set (no lock)" : "several state sets");
 		else
 			printf("  Anonymous\n");
 
@@ -186,7 +218,10 @@ epicsShareFunc void epicsShareAPI seqChanShow(epicsThreadId tid, const char *str
 		else
 			printf("  Not connected\n");
 
-		if (ch->monitored)
+		if (ch->monitored && ch->autoMon)
+			printf("  Monitored automatically (%s, %u state set(s) waiting)\n",
+				dbch && dbch->subscribed ? "on" : "off", ch->autoMonUsers);
+		else if (ch->monitored)
 			printf("  Monitored\n");
 		else
 			printf("  Not monitored\n");
@@ -198,7 +233,7 @@ epicsShareFunc void epicsShareAPI seqChanShow(epicsThreadId tid, const char *str
 
 		if (dbch)
 		{
-			PVMETA	*meta = metaPtr(ch,ss);
+			PVMETA	*meta = seq_ss_meta(ss,ch);
 			char	timeFormatStr[30] = "%Y-%m-%d %H:%M:%S.%06f";
 			char	tsBfr[28];
 
@@ -319,6 +354,79 @@ epicsShareFunc void epicsShareAPI seqQueueShow(epicsThreadId tid)
 	}
 }
 
+/* Order profile entries by decreasing accumulated time */
+static int profileCompare(const void *a, const void *b)
+{
+	const seqProfileEntry *pa = (const seqProfileEntry *)a;
+	const seqProfileEntry *pb = (const seqProfileEntry *)b;
+
+	if (pa->time > pb->time) return -1;
+	if (pa->time < pb->time) return 1;
+	return pa->count > pb->count ? -1 : pa->count < pb->count;
+}
+
+/* This routine is called by traverseProfiles() for seqProfileShow() */
+static int seqProfileShowOne(seqProfile *profile, void *param)
+{
+	const char	*progName = (const char *)param;
+	seqProfileEntry	*entries;
+	double		total = 0.0;
+	unsigned	n;
+
+	if (progName && strcmp(progName, profile->progName) != 0)
+		return FALSE;	/* continue traversal */
+
+	/* take a copy and reset the counters */
+	entries = newArray(seqProfileEntry, profile->numEntries);
+	if (!entries)
+	{
+		errlogSevPrintf(errlogFatal, "seqProfileShow: out of memory\n");
+		return TRUE;
+	}
+	for (n = 0; n < profile->numEntries; n++)
+	{
+		entries[n] = profile->entries[n];
+		profile->entries[n].count = 0;
+		profile->entries[n].time = 0.0;
+		total += entries[n].time;
+	}
+	qsort(entries, profile->numEntries, sizeof(seqProfileEntry), profileCompare);
+
+	printf("Profile of program \"%s\":\n", profile->progName);
+	printf("  %12s %6s %10s %10s  %s\n",
+		"time[s]", "%time", "count", "avg[us]", "block");
+	for (n = 0; n < profile->numEntries; n++)
+	{
+		seqProfileEntry *pe = entries + n;
+
+		if (pe->count == 0)
+			break;
+		printf("  %12.6f %6.1f %10lu %10.3f  ", pe->time,
+			total > 0.0 ? 100.0 * pe->time / total : 0.0,
+			pe->count, 1e6 * pe->time / pe->count);
+		if (pe->ssName)
+			printf("%s/%s ", pe->ssName, pe->stateName);
+		else
+			printf("program ");
+		printf("%s (line %u)\n", pe->kind, pe->line);
+	}
+	free(entries);
+	return progName != NULL;	/* stop after the named program */
+}
+
+/*
+ * seqProfileShow() - Print the profile of a program compiled with +p,
+ * ranked by time spent, and reset it. If no program name is given,
+ * do this for all profiled programs.
+ */
+epicsShareFunc void epicsShareAPI seqProfileShow(const char *progName)
+{
+	if (progName && progName[0] == '\0')
+		progName = NULL;
+	if (!traverseProfiles(seqProfileShowOne, (void *)progName) && progName)
+		printf("No profile for program \"%s\".\n", progName);
+}
+
 /* Read one line from console and parse.
    The input can be:
    - empty (return) as shortcut for '+1'
@@ -0,0 +1,436 @@
+/*************************************************************************\
+Copyright (c) 2010-2015 Helmholtz-Zentrum Berlin f. Materialien
+                        und Energie GmbH, Germany (HZB)
+This file is distributed subject to a Software License Agreement found
+in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+/*************************************************************************\
+                Registry of pvs shared between channels
+\*************************************************************************/
+/*
+ * All channels (of all programs and instances) that are assigned to the
+ * same pv name, in the same pv system, with the same request type, count,
+ * and priority, share a single pv (CA channel) and a single monitor
+ * subscription. Connection and monitor events are fanned out to each
+ * subscribing channel. Completion events for get and put carry their
+ * own request argument and are passed on unchanged.
+ *
+ * The last monitored value is kept only while more than one channel
+ * subscribes, so that a channel that turns its monitor on later gets it
+ * immediately. If there is none (because until then the pv had only one
+ * channel), the current value is read once and passed to the channels
+ * that wait for it.
+ *
+ * Locking: the registry lock protects the hash table and the reference
+ * counts; it is never held while calling out. Each shared pv has its own
+ * lock that serializes all events delivered to its channels. It must be
+ * taken before any program lock, so none of the functions here may be
+ * called with a program lock held.
+ */
+#include "seq.h"
+#include "seq_debug.h"
+
+#define SHARE_HASH_SIZE	256	/* must be a power of 2 */
+
+typedef struct shared_pv SHARED;
+
+struct shared_pv
+{
+	pvVar		pvid;		/* the pv, must be first, see pvShared */
+	/* key */
+	char		*name;		/* pv name */
+	struct ca_client_context *sysId;/* pv system */
+	pvType		type;		/* monitor request type */
+	unsigned	count;		/* monitor element count */
+	unsigned	priority;	/* CA priority */
+	/* protected by the registry lock */
+	unsigned	refCount;	/* number of subscribed channels */
+	SHARED		*next;		/* next in hash chain */
+	/* protected by lock */
+	epicsMutexId	lock;		/* serializes event delivery */
+	CHAN		*chans;		/* list of subscribed channels */
+	unsigned	numChans;	/* number of subscribed channels */
+	unsigned	numMonitors;	/* number of channels that monitor */
+	boolean		connected;	/* whether the pv is connected */
+	boolean		live;		/* monitor delivered a value since connect */
+	boolean		initPending;	/* get for the initial value is pending */
+	PVREQ		initReq;	/* user arg of that get (ss is NULL) */
+	boolean		gotValue;	/* whether lastValue is valid */
+	pvValue		*lastValue;	/* last monitored value (for late subscribers) */
+	size_t		lastSize;	/* allocated size of lastValue */
+	pvType		lastType;	/* type of lastValue */
+	unsigned	lastCount;	/* count of lastValue */
+	pvStat		lastStatus;	/* status of last monitor event */
+};
+
+STATIC_ASSERT(offsetof(struct shared_pv,pvid)==0);
+
+#define pvShared(dbch)	((SHARED *)(dbch)->pvid)
+
+static struct
+{
+	epicsMutexId	lock;
+	SHARED		*table[SHARE_HASH_SIZE];
+} registry;
+
+static void shareInit(void *arg)
+{
+	registry.lock = epicsMutexCreate();
+	if (!registry.lock) {
+		errlogSevPrintf(errlogFatal, "shareInit: epicsMutexCreate failed\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static SHARED **bucket(const char *name)
+{
+	return registry.table + (epicsStrHash(name, 0) & (SHARE_HASH_SIZE-1));
+}
+
+static boolean matches(SHARED *pv, PROG *sp, CHAN *ch)
+{
+	return pv->sysId == sp->pvSys.id
+		&& pv->type == ch->type->getType
+		&& pv->count == ch->count
+		&& pv->priority == ch->priority
+		&& strcmp(pv->name, ch->dbch->dbName) == 0;
+}
+
+static void free_shared(SHARED *pv)
+{
+	if (pv->lock)
+		epicsMutexDestroy(pv->lock);
+	free(pv->lastValue);
+	free(pv->name);
+	free(pv);
+}
+
+/*
+ * Connection handler for a shared pv: remember the new state
+ * and pass the event on to each subscribed channel.
+ */
+static void share_conn_handler(int connected, void *arg)
+{
+	SHARED	*pv = (SHARED *)arg;
+	CHAN	*ch;
+
+	epicsMutexMustLock(pv->lock);
+	pv->connected = connected;
+	if (!connected)
+		pv->gotValue = pv->live = FALSE;
+	for (ch = pv->chans; ch; ch = ch->nextShared)
+		seq_conn_handler(connected, ch);
+	epicsMutexUnlock(pv->lock);
+}
+
+/* Remember a monitored value for channels that subscribe later */
+static void cache_value(
+	SHARED *pv, pvType type, unsigned count, pvValue *value, pvStat status)
+{
+	size_t size = pv_size_n(type, count);
+
+	if (size > pv->lastSize)
+	{
+		free(pv->lastValue);
+		pv->lastValue = (pvValue *)malloc(size);
+		pv->lastSize = pv->lastValue ? size : 0;
+	}
+	if (pv->lastValue)
+	{
+		memcpy(pv->lastValue, value, size);
+		pv->lastType = type;
+		pv->lastCount = count;
+		pv->lastStatus = status;
+		pv->gotValue = TRUE;
+	}
+}
+
+/*
+ * Event handler for a shared pv: monitor events are passed on to each
+ * subscribed channel that monitors the pv, and cached if there is more
+ * than one channel; get and put completion events go directly to the
+ * requesting channel, except for the get issued by seqShareMonitor,
+ * which goes to the channels that wait for a value.
+ */
+static void share_event_handler(
+	pvEventType evt, void *arg, pvType type, unsigned count, pvValue *value, pvStat status)
+{
+	SHARED	*pv;
+	CHAN	*ch;
+	boolean	initial = FALSE;
+
+	if (evt == pvEventMonitor)
+	{
+		pv = (SHARED *)arg;
+	}
+	else if (evt == pvEventGet && !((PVREQ *)arg)->ss)
+	{
+		pv = (SHARED *)((char *)arg - offsetof(SHARED, initReq));
+		initial = TRUE;
+	}
+	else
+	{
+		seq_event_handler(evt, arg, type, count, value, status);
+		return;
+	}
+
+	epicsMutexMustLock(pv->lock);
+	if (initial)
+	{
+		pv->initPending = FALSE;
+		/* channels keep waiting for the next monitor event */
+		if (!value)
+		{
+			epicsMutexUnlock(pv->lock);
+			return;
+		}
+	}
+	if (pv->numMonitors == 0)
+	{
+		/* Last monitor was turned off; it is safe to cancel the
+		   subscription from inside its own callback. */
+		if (!initial)
+		{
+			pvVarMonitorOff(&pv->pvid);
+			pv->live = FALSE;
+		}
+		pv->gotValue = FALSE;
+		epicsMutexUnlock(pv->lock);
+		return;
+	}
+	/* A monitor event may have overtaken the initial get */
+	if (value && pv->numChans > 1 && !(initial && pv->gotValue))
+		cache_value(pv, type, count, value, status);
+	if (!initial)
+		pv->live = TRUE;
+	for (ch = pv->chans; ch; ch = ch->nextShared)
+	{
+		DBCHAN *dbch = ch->dbch;
+
+		if (dbch && dbch->subscribed && (dbch->wantValue || !initial))
+		{
+			dbch->wantValue = FALSE;
+			seq_event_handler(pvEventMonitor, ch, type, count, value, status);
+		}
+	}
+	epicsMutexUnlock(pv->lock);
+}
+
+/*
+ * Find or create the shared pv for the channel's db channel and
+ * subscribe the channel to it. If the pv is already connected, the
+ * channel gets its connection event immediately.
+ */
+pvStat seqShareCreate(CHAN *ch)
+{
+	static epicsThreadOnceId shareOnceFlag = EPICS_THREAD_ONCE_INIT;
+	PROG	*sp = ch->prog;
+	DBCHAN	*dbch = ch->dbch;
+	SHARED	**head, *pv;
+
+	epicsThreadOnce(&shareOnceFlag, shareInit, NULL);
+
+	epicsMutexMustLock(registry.lock);
+	head = bucket(dbch->dbName);
+	for (pv = *head; pv; pv = pv->next)
+	{
+		if (matches(pv, sp, ch))
+			break;
+	}
+	if (!pv)
+	{
+		pvStat status;
+
+		pv = new(SHARED);
+		if (!pv || !(pv->name = epicsStrDup(dbch->dbName))
+			|| !(pv->lock = epicsMutexCreate()))
+		{
+			epicsMutexUnlock(registry.lock);
+			errlogSevPrintf(errlogFatal, "seqShareCreate: out of memory\n");
+			if (pv)
+				free_shared(pv);
+			return pvStatERROR;
+		}
+		pv->sysId = sp->pvSys.id;
+		pv->type = ch->type->getType;
+		pv->count = ch->count;
+		pv->priority = ch->priority;
+		status = pvVarCreate(
+				sp->pvSys,		/* PV system context */
+				pv->name,		/* PV name */
+				pv->priority,		/* CA priority */
+				share_conn_handler,	/* connection handler routine */
+				share_event_handler,	/* event handler routine */
+				pv,			/* private data is shared pv */
+				&pv->pvid);		/* ptr to PV id */
+		if (status != pvStatOK)
+		{
+			epicsMutexUnlock(registry.lock);
+			errlogSevPrintf(errlogFatal, "seqShareCreate(var '%s', pv '%s'): "
+				"pvVarCreate() failure: %s\n", ch->varName, dbch->dbName,
+				pvVarGetMess(pv->pvid));
+			free_shared(pv);
+			return pvStatERROR;
+		}
+		pv->next = *head;
+		*head = pv;
+		DEBUG("seqShareCreate: new shared pv %s\n", pv->name);
+	}
+	pv->refCount++;
+	epicsMutexUnlock(registry.lock);
+
+	epicsMutexMustLock(pv->lock);
+	dbch->pvid = &pv->pvid;
+	dbch->subscribed = FALSE;
+	dbch->wantValue = FALSE;
+	ch->nextShared = pv->chans;
+	pv->chans = ch;
+	pv->numChans++;
+	if (pv->connected)
+		seq_conn_handler(TRUE, ch);
+	epicsMutexUnlock(pv->lock);
+	return pvStatOK;
+}
+
+/*
+ * Unsubscribe the channel from the shared pv of the given db channel
+ * (which may already be detached from the channel). The pv itself gets
+ * destroyed when the last channel unsubscribes.
+ */
+pvStat seqShareDestroy(CHAN *ch, DBCHAN *dbch)
+{
+	SHARED	*pv = pvShared(dbch);
+	CHAN	**pch;
+	pvStat	status = pvStatOK;
+
+	epicsMutexMustLock(pv->lock);
+	for (pch = &pv->chans; *pch; pch = &(*pch)->nextShared)
+	{
+		if (*pch == ch)
+		{
+			*pch = ch->nextShared;
+			pv->numChans--;
+			break;
+		}
+	}
+	ch->nextShared = NULL;
+	if (dbch->subscribed)
+	{
+		dbch->subscribed = FALSE;
+		pv->numMonitors--;
+	}
+	dbch->wantValue = FALSE;
+	/* A single channel does not need the cache, see share_event_handler */
+	if (pv->numChans <= 1)
+		pv->gotValue = FALSE;
+	epicsMutexUnlock(pv->lock);
+
+	epicsMutexMustLock(registry.lock);
+	if (--pv->refCount == 0)
+	{
+		SHARED **ppv;
+
+		for (ppv = bucket(pv->name); *ppv; ppv = &(*ppv)->next)
+		{
+			if (*ppv == pv)
+			{
+				*ppv = pv->next;
+				break;
+			}
+		}
+	}
+	else
+	{
+		pv = NULL;
+	}
+	epicsMutexUnlock(registry.lock);
+
+	if (pv)
+	{
+		DEBUG("seqShareDestroy: destroy shared pv %s\n", pv->name);
+		/* Must not hold any lock here, pvVarDestroy waits
+		   for pending callbacks to complete. */
+		status = pvVarDestroy(&pv->pvid);
+		if (status != pvStatOK)
+			errlogSevPrintf(errlogFatal, "seqShareDestroy(var '%s', pv '%s'): "
+				"pvVarDestroy() failure: %s\n", ch->varName, dbch->dbName,
+				pvVarGetMess(pv->pvid));
+		free_shared(pv);
+	}
+	dbch->pvid = NULL;
+	return status;
+}
+
+/*
+ * Turn the channel's share of the monitor subscription on or off.
+ * The first channel that turns it on creates the subscription; later
+ * ones get the last monitored value immediately, if there is one, or
+ * else as soon as a get for the current value completes.
+ * After the last channel turned it off, the subscription gets
+ * cancelled when the next monitor event arrives.
+ */
+pvStat seqShareMonitor(CHAN *ch, boolean turn_on)
+{
+	DBCHAN	*dbch = ch->dbch;
+	SHARED	*pv = pvShared(dbch);
+	pvStat	status = pvStatOK;
+
+	epicsMutexMustLock(pv->lock);
+	if (turn_on && !dbch->subscribed)
+	{
+		dbch->subscribed = TRUE;
+		pv->numMonitors++;
+		if (!pvMonIsDefined(pv->pvid))
+		{
+			status = pvVarMonitorOn(
+					&pv->pvid,	/* pvid */
+					pv->type,	/* requested type */
+					pv->count,	/* element count */
+					pv);		/* user arg (shared pv) */
+			if (status != pvStatOK)
+			{
+				dbch->subscribed = FALSE;
+				pv->numMonitors--;
+			}
+		}
+		else if (pv->gotValue)
+		{
+			seq_event_handler(pvEventMonitor, ch, pv->lastType,
+				pv->lastCount, pv->lastValue, pv->lastStatus);
+		}
+		else if (pv->live)
+		{
+			/* The value was not cached; read it once */
+			dbch->wantValue = TRUE;
+			if (!pv->initPending && pvVarGetCallback(&pv->pvid,
+				pv->type, pv->count, &pv->initReq) == pvStatOK)
+			{
+				pv->initPending = TRUE;
+			}
+		}
+	}
+	else if (!turn_on && dbch->subscribed)
+	{
+		dbch->subscribed = FALSE;
+		dbch->wantValue = FALSE;
+		pv->numMonitors--;
+	}
+	epicsMutexUnlock(pv->lock);
+	return status;
+}
+
+/*
+ * Number of channels subscribed to the channel's shared pv.
+ */
+unsigned seqShareCount(CHAN *ch)
+{
+	unsigned count = 0;
+
+	if (ch->dbch && ch->dbch->pvid)
+	{
+		epicsMutexMustLock(registry.lock);
+		count = pvShared(ch->dbch)->refCount;
+		epicsMutexUnlock(registry.lock);
+	}
+	return count;
+}
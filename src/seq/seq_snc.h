@@ -43,6 +43,12 @@ extern "C" {
 #define OPT_REENT		((seqMask)1u<<3)	/* generate reentrant code */
 #define OPT_NEWEF		((seqMask)1u<<4)	/* new event flag mode */
 #define OPT_SAFE		((seqMask)1u<<5)	/* safe mode */
+#define OPT_CACHEGET		((seqMask)1u<<6)	/* sync. gets from monitor cache */
+#define OPT_COMBINE		((seqMask)1u<<7)	/* combine puts within an action */
+#define OPT_LAZY		((seqMask)1u<<8)	/* connect channels on first use */
+#define OPT_AUTOMON		((seqMask)1u<<9)	/* monitor only while a state waits */
+#define OPT_BLOCKS		((seqMask)1u<<10)	/* refresh only changed blocks */
+#define OPT_PROFILE		((seqMask)1u<<11)	/* profile generated code */
 
 /* Bit encoding for state specific options */
 #define OPT_NORESETTIMERS	((seqMask)1u<<0)	/* Don't reset timers on */
@@ -82,6 +88,7 @@ struct seqChan
 	seqBool		monitored;	/* whether channel should be monitored */
 	unsigned	queueSize;	/* syncQ queue size (0=not queued) */
 	unsigned	queueIndex;	/* syncQ queue index */
+	int		priority;	/* CA priority (-1=default) */
 };
 
 /* Static information about a state */
@@ -102,6 +109,13 @@ struct seqSS
 	const char	*ssName;	/* state set name */
 	seqState	*states;	/* array of state blocks */
 	unsigned	numStates;	/* number of states in this state set */
+	const unsigned	*chans;		/* sorted numbers of channels used,
+					   NULL if not known */
+	unsigned	numChans;	/* number of channels used */
+	const seqMask	*readMask;	/* channels whose value is read,
+					   NULL if not known */
+	const seqMask	*putMask;	/* channels passed to pvPut,
+					   NULL if not known */
 };
 
 /* Static information about a state program */
@@ -123,12 +137,40 @@ struct seqProgram
 	unsigned	numQueues;	/* number of syncQ queues */
 };
 
+typedef struct seqProfileEntry seqProfileEntry;
+typedef struct seqProfile seqProfile;
+
+/* Profile counters for a block of generated code (option +p) */
+struct seqProfileEntry
+{
+	const char	*ssName;	/* state set name, NULL for program */
+	const char	*stateName;	/* state name, NULL for program */
+	const char	*kind;		/* "when", "action", "entry", or "exit" */
+	unsigned	line;		/* source line of the block */
+	unsigned long	count;		/* number of times executed */
+	double		time;		/* accumulated time in seconds */
+};
+
+/* Profile table of a state program (option +p) */
+struct seqProfile
+{
+	const char	*progName;	/* program name */
+	seqProfileEntry	*entries;	/* array of profile entries */
+	unsigned	numEntries;	/* number of profile entries */
+	seqProfile	*next;		/* next registered profile */
+};
+
 epicsShareFunc void seq_efInit(PROG_ID sp, EF_ID ev_flag, unsigned val);
 
 /* called by generated main and registrar routines */
 epicsShareFunc void seqRegisterSequencerProgram(seqProgram *p);
 epicsShareFunc void seqRegisterSequencerCommands(void);
 
+/* called by code generated with option +p */
+epicsShareFunc void seq_profileRegister(seqProfile *profile);
+epicsShareFunc double seq_profileStart(void);
+epicsShareFunc void seq_profileLap(seqProfileEntry *entry, double *lap);
+
 /*
  * These function prototypes are intentionally left out of the public API in
  * seqCom.h. They will be moved there in version 2.3 with slightly modified
@@ -146,6 +188,24 @@ epicsShareFunc pvStat seq_pvArrayStopMonitor(SS_ID, CH_ID, unsigned);
 epicsShareFunc void seq_pvArraySync(SS_ID, CH_ID, unsigned, EF_ID);
 epicsShareFunc seqBool seq_pvArrayConnected(SS_ID ss, CH_ID chId, unsigned length);
 
+/*
+ * Variants of built-in functions for safe (+s) and traditional (-s) mode.
+ * snc calls these instead of the generic ones, which test the mode at
+ * run-time. Not for use in embedded C code.
+ */
+epicsShareFunc pvStat seq_pvGetTmoSafe(SS_ID, CH_ID, enum compType, double tmo);
+epicsShareFunc pvStat seq_pvGetTmoTrad(SS_ID, CH_ID, enum compType, double tmo);
+epicsShareFunc pvStat seq_pvPutTmoSafe(SS_ID, CH_ID, enum compType, double tmo);
+epicsShareFunc pvStat seq_pvPutTmoTrad(SS_ID, CH_ID, enum compType, double tmo);
+epicsShareFunc seqBool seq_pvConnectedSafe(SS_ID, CH_ID);
+epicsShareFunc seqBool seq_pvConnectedTrad(SS_ID, CH_ID);
+epicsShareFunc seqBool seq_pvArrayConnectedSafe(SS_ID, CH_ID, unsigned length);
+epicsShareFunc seqBool seq_pvArrayConnectedTrad(SS_ID, CH_ID, unsigned length);
+epicsShareFunc seqBool seq_efTestSafe(SS_ID, EF_ID);
+epicsShareFunc seqBool seq_efTestTrad(SS_ID, EF_ID);
+epicsShareFunc seqBool seq_efTestAndClearSafe(SS_ID, EF_ID);
+epicsShareFunc seqBool seq_efTestAndClearTrad(SS_ID, EF_ID);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
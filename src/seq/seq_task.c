@@ -14,6 +14,11 @@ in the file LICENSE that is included with this distribution.
 #include "seq_debug.h"
 
 static void ss_entry(void *arg);
+static boolean init_snapshots(PROG *sp);
+static void init_ss_var(PROG *sp, SSCB *ss);
+static void automon_start(PROG *sp);
+static void automon_enter(SSCB *ss, const bitMask *oldMask, const bitMask *newMask);
+static void automon_expire(SSCB *ss, double now);
 
 /*
  * sequencer() - Sequencer main thread entry point.
@@ -42,20 +47,28 @@ void sequencer (void *arg)	/* ptr to original (global) state program table */
 	/* Call sequencer init function to initialize variables. */
 	sp->initFunc(sp);
 
-	/* Initialize state set variables. In safe mode, copy variable
-	   block to state set buffers. Must do all this before connecting. */
+	/* Initialize state set variables. In safe mode, move large values
+	   to snapshots and copy variable block to state set buffers. Must
+	   do all this before connecting. */
 	if (optTest(sp, OPT_SAFE))
 	{
-		for (nss = 0; nss < sp->numSS; nss++)
+		if (!init_snapshots(sp))
 		{
-			SSCB	*ss = sp->ss + nss;
-			memcpy(ss->var, sp->var, sp->varSize);
+			sp->die = TRUE;
+			goto exit;
 		}
+		for (nss = 0; nss < sp->numSS; nss++)
+			init_ss_var(sp, sp->ss + nss);
 	}
 
 	/* Attach to PV system */
 	pvSysAttach(sp->pvSys);
 
+	/* Automatic monitors start out on; those that no state waits
+	   for get turned off after the grace period. */
+	if (optTest(sp, OPT_AUTOMON))
+		automon_start(sp);
+
 	/* Initiate connect & monitor requests to database channels, waiting
 	   for all connections to be established if the option is set. */
 	if (seq_connect(sp, optTest(sp, OPT_CONN) != pvStatOK))
@@ -72,7 +85,11 @@ void sequencer (void *arg)	/* ptr to original (global) state program table */
 
 	/* Call program entry function if defined.
 	   Treat as if called from 1st state set. */
-	if (sp->entryFunc) sp->entryFunc(sp->ss);
+	if (sp->entryFunc)
+	{
+		sp->entryFunc(sp->ss);
+		ss_flush_puts(sp->ss);
+	}
 
 	/* Create each additional state set task (additional state set thread
 	   names are derived from the first ss) */
@@ -109,7 +126,11 @@ void sequencer (void *arg)	/* ptr to original (global) state program table */
 
 	/* Call program exit function if defined.
 	   Treat as if called from 1st state set. */
-	if (sp->exitFunc) sp->exitFunc(sp->ss);
+	if (sp->exitFunc)
+	{
+		sp->exitFunc(sp->ss);
+		ss_flush_puts(sp->ss);
+	}
 
 exit:
 	DEBUG("   Disconnect all channels\n");
@@ -125,41 +146,341 @@ exit:
 	seq_free(sp);
 }
 
+/*
+ * seq_ss_slot() - Return the request slot of channel number nch
+ * in state set ss, or NO_SLOT if the state set does not use the channel.
+ * The slot indexes the getReq, putReq, metaData, and dirty arrays.
+ */
+unsigned seq_ss_slot(SSCB *ss, unsigned nch)
+{
+	unsigned lo = 0, hi = ss->numSlots;
+
+	if (!ss->slotChan)
+		return nch;
+	/* binary search in the sorted list of used channels */
+	while (lo < hi)
+	{
+		unsigned mid = lo + (hi - lo) / 2;
+
+		if (ss->slotChan[mid] < nch)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo < ss->numSlots && ss->slotChan[lo] == nch ? lo : NO_SLOT;
+}
+
+/*
+ * seq_ss_meta() - Return the meta data of channel ch as seen by
+ * state set ss, or NULL if the channel is anonymous.
+ */
+PVMETA *seq_ss_meta(SSCB *ss, CHAN *ch)
+{
+	unsigned slot;
+
+	if (!ch->dbch)
+		return NULL;
+	if (!optTest(ch->prog, OPT_SAFE))
+		return &ch->dbch->metaData;
+	slot = seq_ss_slot(ss, chNum(ch));
+	/* fall back to the shared buffer for channels the state set
+	   does not use */
+	return slot == NO_SLOT ? &ch->dbch->metaData : ss->metaData + slot;
+}
+
+/*
+ * Large channel values in safe mode: the shared value of a channel with
+ * at least SNAPSHOT_MIN_SIZE bytes lives in a reference counted snapshot
+ * instead of the shared variable block. A state set refreshing its copy
+ * takes a reference while holding the channel's varLock, but copies the
+ * bytes after releasing it. A writer fills a spare snapshot without
+ * holding the lock and then publishes it by swapping pointers. Snapshots
+ * nobody references any more become the channel's spare, so that in the
+ * steady state no memory is allocated (triple buffering: the current
+ * snapshot, the one a reader still copies from, and the spare).
+ *
+ * Each published snapshot gets a new version number, and each of its
+ * blocks of SNAPSHOT_BLOCK_SIZE bytes is labelled with the version that
+ * last changed the block. Equal labels mean equal block contents. With
+ * option +k, a writer compares the new value with the current snapshot
+ * and copies to the spare only blocks that differ from what the spare
+ * already holds, and a state set copies only blocks labelled with a
+ * version newer than the one it saw last (see seen in SSCB).
+ */
+static SNAPSHOT *snapshot_new(size_t size)
+{
+	unsigned numBlocks = (unsigned)((size + SNAPSHOT_BLOCK_SIZE - 1)
+		/ SNAPSHOT_BLOCK_SIZE);
+	size_t	valSize = (size + sizeof(unsigned) - 1)
+		& ~(sizeof(unsigned) - 1);
+	SNAPSHOT *snap = (SNAPSHOT *)malloc(offsetof(SNAPSHOT, value)
+		+ valSize + numBlocks * sizeof(unsigned));
+
+	if (snap)
+	{
+		snap->refCount = 1;
+		/* no valid contents yet */
+		snap->size = 0;
+		snap->version = 0;
+		snap->numBlocks = numBlocks;
+		snap->blockVersion = (unsigned *)((char *)snap->value + valSize);
+		memset(snap->blockVersion, 0, numBlocks * sizeof(unsigned));
+	}
+	return snap;
+}
+
+/* Whether version a is newer than version b, allowing for wrap around */
+static boolean version_newer(unsigned a, unsigned b)
+{
+	return (int)(a - b) > 0;
+}
+
+/*
+ * Fill snapshot snap with size bytes from val. With blocks TRUE and
+ * the sizes matching, copy only blocks that differ from what snap holds,
+ * using base (the current snapshot) to find the unchanged ones. Changed
+ * blocks are labelled 0 until snapshot_publish assigns the version.
+ */
+static void snapshot_fill(SNAPSHOT *snap, const SNAPSHOT *base,
+	const char *val, size_t size, boolean blocks)
+{
+	unsigned b;
+
+	if (!blocks || base->size != size || snap->size != size)
+	{
+		memcpy(snap->value, val, size);
+		memset(snap->blockVersion, 0, snap->numBlocks * sizeof(unsigned));
+	}
+	else for (b = 0; b < snap->numBlocks; b++)
+	{
+		size_t	start = (size_t)b * SNAPSHOT_BLOCK_SIZE;
+		size_t	len;
+		unsigned label;
+
+		if (start >= size)
+		{
+			snap->blockVersion[b] = 0;
+			continue;
+		}
+		len = size - start < SNAPSHOT_BLOCK_SIZE ?
+			size - start : SNAPSHOT_BLOCK_SIZE;
+		label = memcmp(val + start, (const char *)base->value + start,
+			len) ? 0 : base->blockVersion[b];
+		if (!label || label != snap->blockVersion[b])
+			memcpy((char *)snap->value + start, val + start, len);
+		snap->blockVersion[b] = label;
+	}
+	snap->size = size;
+}
+
+/*
+ * Make snap, filled relative to base, the current snapshot of a channel
+ * and return the previous one. Must hold ch->varLock. If another writer
+ * published in the mean time, every block is labelled as changed.
+ */
+static SNAPSHOT *snapshot_publish(CHAN *ch, SNAPSHOT *snap,
+	const SNAPSHOT *base)
+{
+	SNAPSHOT *old = ch->snapshot;
+	unsigned version = old->version + 1;
+	unsigned b;
+
+	if (!version)
+		version = 1;
+	for (b = 0; b < snap->numBlocks; b++)
+	{
+		if (old != base || !snap->blockVersion[b])
+			snap->blockVersion[b] = version;
+	}
+	snap->version = version;
+	ch->snapshot = snap;
+	return old;
+}
+
+/*
+ * Copy the value of a snapshot to a state set's copy at dest that
+ * holds the snapshot version seen, or copy everything if seen is 0.
+ */
+static void snapshot_copy(char *dest, const SNAPSHOT *snap, unsigned seen)
+{
+	unsigned b;
+
+	if (!seen)
+	{
+		memcpy(dest, snap->value, snap->size);
+		return;
+	}
+	for (b = 0; b < snap->numBlocks; b++)
+	{
+		size_t start = (size_t)b * SNAPSHOT_BLOCK_SIZE;
+
+		if (start >= snap->size)
+			break;
+		if (version_newer(snap->blockVersion[b], seen))
+			memcpy(dest + start, (const char *)snap->value + start,
+				snap->size - start < SNAPSHOT_BLOCK_SIZE ?
+				snap->size - start : SNAPSHOT_BLOCK_SIZE);
+	}
+}
+
+/* Drop a reference to a snapshot. Must hold ch->varLock. Returns the
+   snapshot if the caller has to free it. */
+static SNAPSHOT *snapshot_unref(CHAN *ch, SNAPSHOT *snap)
+{
+	if (--snap->refCount)
+		return NULL;
+	if (!ch->spare)
+	{
+		ch->spare = snap;
+		return NULL;
+	}
+	return snap;
+}
+
+static void snapshot_release(CHAN *ch, SNAPSHOT *snap)
+{
+	epicsMutexMustLock(ch->varLock);
+	snap = snapshot_unref(ch, snap);
+	epicsMutexUnlock(ch->varLock);
+	free(snap);
+}
+
+/*
+ * init_snapshots() - Create the initial snapshot of each large
+ * channel from the shared variable block.
+ */
+static boolean init_snapshots(PROG *sp)
+{
+	unsigned nch, n;
+
+	for (nch = 0; nch < sp->numChans; nch++)
+	{
+		CHAN	*ch = sp->chan + nch;
+		size_t	size = ch->type->size * ch->count;
+
+		/* queued channels don't use the shared buffer */
+		if (size < SNAPSHOT_MIN_SIZE || ch->queue)
+			continue;
+		ch->snapshot = snapshot_new(size);
+		if (!ch->snapshot)
+		{
+			errlogSevPrintf(errlogFatal, "init_snapshots: malloc failed\n");
+			return FALSE;
+		}
+		memcpy(ch->snapshot->value, bufPtr(ch), size);
+		ch->snapshot->size = size;
+		ch->snapshot->version = 1;
+		for (n = 0; n < ch->snapshot->numBlocks; n++)
+			ch->snapshot->blockVersion[n] = 1;
+	}
+	return TRUE;
+}
+
+/*
+ * ss_free_snapshots() - Release the snapshots of a program instance.
+ */
+void ss_free_snapshots(PROG *sp)
+{
+	unsigned nch;
+
+	for (nch = 0; nch < sp->numChans; nch++)
+	{
+		free(sp->chan[nch].snapshot);
+		free(sp->chan[nch].spare);
+	}
+}
+
+static int cmp_offset(const void *a, const void *b)
+{
+	size_t x = chHot(*(CHAN *const *)a)->offset;
+	size_t y = chHot(*(CHAN *const *)b)->offset;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * init_ss_var() - Copy the initial values to the variable block
+ * of a state set, leaving out large channels the state set does
+ * not use, so that their part of the block is never touched.
+ */
+static void init_ss_var(PROG *sp, SSCB *ss)
+{
+	CHAN	**skip = newArray(CHAN *, sp->numChans);
+	unsigned nch, n, numSkip = 0;
+	size_t	done = 0;
+
+	/* if out of memory, simply copy everything */
+	for (nch = 0; skip && nch < sp->numChans; nch++)
+	{
+		if (sp->chan[nch].snapshot && seq_ss_slot(ss, nch) == NO_SLOT)
+			skip[numSkip++] = sp->chan + nch;
+	}
+	if (numSkip)
+		qsort(skip, numSkip, sizeof(CHAN *), cmp_offset);
+	for (n = 0; n < numSkip; n++)
+	{
+		CHAN *ch = skip[n];
+
+		memcpy((char *)ss->var + done, (char *)sp->var + done,
+			chHot(ch)->offset - done);
+		done = chHot(ch)->offset + ch->type->size * ch->count;
+	}
+	memcpy((char *)ss->var + done, (char *)sp->var + done, sp->varSize - done);
+	free(skip);
+}
+
 /*
  * ss_read_buffer_static() - static version of ss_read_buffer.
  * This is to enable inlining in the for loop in ss_read_all_buffer.
  */
-static void ss_read_buffer_static(SSCB *ss, CHAN *ch, boolean dirty_only)
+static void ss_read_buffer_static(SSCB *ss, CHAN *ch, unsigned slot,
+	boolean dirty_only)
 {
-	char *val = valPtr(ch,ss);
-	char *buf = bufPtr(ch);
-	ptrdiff_t nch = chNum(ch);
-	/* Must take dbCount for db channels, else we overwrite
-	   elements we didn't get */
-	size_t count = ch->dbch ? ch->dbch->dbCount : ch->count;
-	size_t var_size = ch->type->size * count;
+	CHANHOT *hot;
+	SNAPSHOT *snap;
 
-	if (!ss->dirty[nch] && dirty_only)
+	if (dirty_only && (slot == NO_SLOT || !ss->dirty[slot]))
 		return;
 
+	hot = chHot(ch);
+
 	epicsMutexMustLock(ch->varLock);
 
 	DEBUG("ss %s: before read %s", ss->ssName, ch->varName);
-	print_channel_value(DEBUG, ch, val);
-
-	memcpy(val, buf, var_size);
-	if (ch->dbch)
+	print_channel_value(DEBUG, ch, valPtr(ch,ss));
+
+	snap = ch->snapshot;
+	if (snap)
+		snap->refCount++;
+	else
+		copyValue((char*)ss->var + hot->offset,
+			(char*)ss->prog->var + hot->offset, hot->size);
+	if (slot != NO_SLOT)
 	{
-		/* structure copy */
-		ss->metaData[nch] = ch->dbch->metaData;
+		if (ch->dbch)
+			/* structure copy */
+			ss->metaData[slot] = ch->dbch->metaData;
+		ss->dirty[slot] = FALSE;
 	}
 
-	DEBUG("ss %s: after read %s", ss->ssName, ch->varName);
-	print_channel_value(DEBUG, ch, val);
+	epicsMutexUnlock(ch->varLock);
 
-	ss->dirty[nch] = FALSE;
+	if (snap)
+	{
+		/* copy outside the lock, the snapshot does not change */
+		if (ss->seen && slot != NO_SLOT)
+		{
+			snapshot_copy((char*)ss->var + hot->offset, snap,
+				ss->seen[slot]);
+			ss->seen[slot] = snap->version;
+		}
+		else
+			snapshot_copy((char*)ss->var + hot->offset, snap, 0);
+		snapshot_release(ch, snap);
+	}
 
-	epicsMutexUnlock(ch->varLock);
+	DEBUG("ss %s: after read %s", ss->ssName, ch->varName);
+	print_channel_value(DEBUG, ch, valPtr(ch,ss));
 }
 
 /*
@@ -170,22 +491,25 @@ static void ss_read_buffer_static(SSCB *ss, CHAN *ch, boolean dirty_only)
  */
 void ss_read_buffer(SSCB *ss, CHAN *ch, boolean dirty_only)
 {
-	ss_read_buffer_static(ss, ch, dirty_only);
+	ss_read_buffer_static(ss, ch, seq_ss_slot(ss, chNum(ch)), dirty_only);
 }
 
 /*
  * ss_read_all_buffer() - Call ss_read_buffer_static
- * for all channels.
+ * for all channels the state set uses.
  */
 static void ss_read_all_buffer(PROG *sp, SSCB *ss)
 {
-	unsigned nch;
+	unsigned slot;
 
-	for (nch = 0; nch < sp->numChans; nch++)
+	for (slot = 0; slot < ss->numSlots; slot++)
 	{
-		CHAN *ch = sp->chan + nch;
-		/* Call static version so it gets inlined */
-		ss_read_buffer_static(ss, ch, TRUE);
+		/* Only the dirty flags are touched for unchanged channels */
+		if (ss->dirty[slot])
+			/* Call static version so it gets inlined */
+			ss_read_buffer_static(ss, sp->chan +
+				(ss->slotChan ? ss->slotChan[slot] : slot),
+				slot, FALSE);
 	}
 }
 
@@ -201,7 +525,7 @@ void ss_read_buffer_selective(PROG *sp, SSCB *ss, EF_ID ev_flag)
 	while (ch)
 	{
 		/* Call static version so it gets inlined */
-		ss_read_buffer_static(ss, ch, TRUE);
+		ss_read_buffer_static(ss, ch, seq_ss_slot(ss, chNum(ch)), TRUE);
 		ch = ch->nextSynced;
 	}
 }
@@ -209,25 +533,86 @@ void ss_read_buffer_selective(PROG *sp, SSCB *ss, EF_ID ev_flag)
 /*
  * ss_write_buffer() - Copy given value and meta data
  * to shared buffer. In safe mode, if dirtify is TRUE then
- * set dirty flag for each state set.
+ * set dirty flag for each state set that reads the channel,
+ * except the writer (if any) whose copy is already up to date.
  */
-void ss_write_buffer(CHAN *ch, void *val, PVMETA *meta, boolean dirtify)
+void ss_write_buffer(SSCB *writer, CHAN *ch, void *val, PVMETA *meta,
+	boolean dirtify)
 {
 	PROG *sp = ch->prog;
 	char *buf = bufPtr(ch);		/* shared buffer */
-	/* Must use dbCount for db channels, else we overwrite
-	   elements we didn't get */
-	size_t count = ch->dbch ? ch->dbch->dbCount : ch->count;
-	size_t var_size = ch->type->size * count;
 	ptrdiff_t nch = chNum(ch);
-	unsigned nss;
+	size_t var_size = sp->chanHot[nch].size;
+	SNAPSHOT *snap = NULL, *base = NULL;
+	unsigned nss, seq = 0;
+
+	if (ch->snapshot)
+	{
+		/* Fill the spare snapshot outside the lock. Writes are
+		   numbered in the order they start, so that a write that
+		   finishes after a later one can be dropped. */
+		epicsMutexMustLock(ch->varLock);
+		snap = ch->spare;
+		ch->spare = NULL;
+		base = ch->snapshot;
+		base->refCount++;
+		seq = ++ch->writeSeq;
+		epicsMutexUnlock(ch->varLock);
+		if (!snap)
+			snap = snapshot_new(ch->type->size * ch->count);
+		if (!snap)
+		{
+			errlogSevPrintf(errlogFatal,
+				"ss_write_buffer(%s): malloc failed\n", ch->varName);
+			snapshot_release(ch, base);
+			return;
+		}
+		snapshot_fill(snap, base, (const char *)val, var_size,
+			optTest(sp, OPT_BLOCKS));
+		snap->refCount = 1;
+	}
 
 	epicsMutexMustLock(ch->varLock);
 
 	DEBUG("ss_write_buffer: before write %s", ch->varName);
 	print_channel_value(DEBUG, ch, buf);
 
-	memcpy(buf, val, var_size);
+	if (snap && !version_newer(seq, ch->publishSeq))
+	{
+		/* a later write was published first, ours is stale */
+		unsigned slot;
+
+		DEBUG("ss_write_buffer: drop stale write %u of %s\n", seq,
+			ch->varName);
+		/* the writer's copy must be refreshed completely (it is
+		   dirty because of the later write) */
+		if (writer && writer->seen
+			&& (slot = seq_ss_slot(writer, (unsigned)nch)) != NO_SLOT)
+			writer->seen[slot] = 0;
+		base = snapshot_unref(ch, base);
+		snap = snapshot_unref(ch, snap);
+		epicsMutexUnlock(ch->varLock);
+		free(snap);
+		free(base);
+		return;
+	}
+	if (snap)
+	{
+		/* publish it, the previous one becomes the spare unless
+		   a reader still copies from it */
+		SNAPSHOT *old = snapshot_publish(ch, snap, base);
+		unsigned slot;
+
+		ch->publishSeq = seq;
+		/* the writer's copy is the new value */
+		if (writer && writer->seen
+			&& (slot = seq_ss_slot(writer, (unsigned)nch)) != NO_SLOT)
+			writer->seen[slot] = snap->version;
+		base = snapshot_unref(ch, base);
+		snap = snapshot_unref(ch, old);
+	}
+	else
+		copyValue(buf, val, var_size);
 	if (ch->dbch && meta)
 		/* structure copy */
 		ch->dbch->metaData = *meta;
@@ -237,9 +622,23 @@ void ss_write_buffer(CHAN *ch, void *val, PVMETA *meta, boolean dirtify)
 
 	if (optTest(sp, OPT_SAFE) && dirtify)
 		for (nss = 0; nss < sp->numSS; nss++)
-			sp->ss[nss].dirty[nch] = TRUE;
+		{
+			SSCB *ss = sp->ss + nss;
+			unsigned slot;
+
+			if (ss == writer
+				|| (ss->readMask && !bitTest(ss->readMask, nch)))
+				continue;
+			slot = seq_ss_slot(ss, (unsigned)nch);
+			if (slot != NO_SLOT)
+				ss->dirty[slot] = TRUE;
+		}
 
 	epicsMutexUnlock(ch->varLock);
+
+	/* superfluous spares (two writers raced) */
+	free(snap);
+	free(base);
 }
 
 /*
@@ -250,11 +649,16 @@ static void ss_entry(void *arg)
 {
 	SSCB		*ss = (SSCB *)arg;
 	PROG		*sp = ss->prog;
+	/* options tested in the main loop don't change at run-time */
+	boolean		safe = optTest(sp, OPT_SAFE);
+	boolean		newef = optTest(sp, OPT_NEWEF);
+	boolean		automon = optTest(sp, OPT_AUTOMON);
 
 	/* Attach to PV system; was already done for the first state set */
 	if (ss != sp->ss)
 	{
 		ss->threadId = epicsThreadGetIdSelf();
+		seqAddStateSet(ss);
 		createOrAttachPvSystem(sp);
 	}
 
@@ -265,7 +669,7 @@ static void ss_entry(void *arg)
 	   entering the event loop. Must do this using
 	   ss_read_all_buffer since CA and other state sets could
 	   already post events resp. pvPut. */
-	if (optTest(sp, OPT_SAFE))
+	if (safe)
 		ss_read_all_buffer(sp, ss);
 
 	/* Initial state is the first one */
@@ -291,6 +695,16 @@ static void ss_entry(void *arg)
 		/* Set state set event mask to this state's event mask */
 		ss->mask = st->eventMask;
 
+		/* Monitor what this state waits for (+u) */
+		if (automon && ss->prevState != ss->currentState)
+			automon_enter(ss, ss->prevState >= 0 ?
+				ss->states[ss->prevState].eventMask : NULL,
+				st->eventMask);
+
+		/* Connect lazy channels that this state waits for */
+		if (sp->lazyCount && ss->prevState != ss->currentState)
+			seq_connect_lazy_mask(sp, st->eventMask);
+
 		/* If we've changed state, do any entry actions. Also do these
 		 * even if it's the same state if option to do so is enabled.
 		 */
@@ -298,6 +712,7 @@ static void ss_entry(void *arg)
 			|| optTest(st, OPT_DOENTRYFROMSELF)))
 		{
 			st->entryFunc(ss);
+			ss_flush_puts(ss);
 		}
 
 		/* Flush any outstanding DB requests */
@@ -323,10 +738,21 @@ static void ss_entry(void *arg)
 		/* Loop until an event is triggered, i.e. when() returns TRUE
 		 */
 		do {
+			double wakeupTime = ss->wakeupTime;
+
+			/* Turn off automatic monitors after their grace period */
+			if (ss->autoMonNext)
+			{
+				if (ss->autoMonNext <= now)
+					automon_expire(ss, now);
+				if (ss->autoMonNext && ss->autoMonNext < wakeupTime)
+					wakeupTime = ss->autoMonNext;
+			}
+
 			/* Wake up on PV event, event flag, or expired delay */
 			DEBUG("before epicsEventWaitWithTimeout(ss=%d,timeout=%f)\n",
-				ss - sp->ss, ss->wakeupTime - now);
-			epicsEventWaitWithTimeout(ss->syncSem, ss->wakeupTime - now);
+				ss - sp->ss, wakeupTime - now);
+			epicsEventWaitWithTimeout(ss->syncSem, wakeupTime - now);
 			DEBUG("after epicsEventWaitWithTimeout()\n");
 
 			/* Check whether we have been asked to exit */
@@ -335,7 +761,7 @@ static void ss_entry(void *arg)
 			/* Copy dirty variable values from CA buffer
 			 * to user (safe mode only).
 			 */
-			if (optTest(sp, OPT_SAFE))
+			if (safe)
 				ss_read_all_buffer(sp, ss);
 
 			ss->wakeupTime = epicsINF;
@@ -345,7 +771,7 @@ static void ss_entry(void *arg)
 				&transNum, &ss->nextState);
 
 			/* Clear all event flags (old ef mode only) */
-			if (ev_trig && !optTest(sp, OPT_NEWEF))
+			if (ev_trig && !newef)
 			{
 				unsigned i;
 				for (i = 0; i < NWORDS(sp->numEvFlags); i++)
@@ -360,6 +786,9 @@ static void ss_entry(void *arg)
 		/* Execute the state change action */
 		st->actionFunc(ss, transNum, &ss->nextState);
 
+		/* Issue puts that were combined during the action (+b only) */
+		ss_flush_puts(ss);
+
 		/* Check whether we have been asked to exit */
 		if (sp->die) goto exit;
 
@@ -368,6 +797,7 @@ static void ss_entry(void *arg)
 			|| optTest(st, OPT_DOEXITTOSELF)))
 		{
 			st->exitFunc(ss);
+			ss_flush_puts(ss);
 		}
 
 		/* Change to next state */
@@ -397,6 +827,120 @@ epicsShareFunc void epicsShareAPI seqStop(epicsThreadId tid)
 	seq_exit(sp->ss);
 }
 
+/*
+ * automon_start() - Schedule all automatic monitors to be turned off
+ * after the grace period, unless a state set enters a state that waits
+ * for them before then.
+ */
+static void automon_start(PROG *sp)
+{
+	unsigned nch, nss;
+	double	now;
+
+	pvTimeGetCurrentDouble(&now);
+	epicsMutexMustLock(sp->lock);
+	for (nch = 0; nch < sp->numChans; nch++)
+	{
+		CHAN *ch = sp->chan + nch;
+
+		if (ch->autoMon)
+			ch->autoMonOff = now + sp->monGrace;
+	}
+	epicsMutexUnlock(sp->lock);
+	for (nss = 0; nss < sp->numSS; nss++)
+		sp->ss[nss].autoMonNext = now + sp->monGrace;
+}
+
+/*
+ * automon_enter() - Account for a state change from a state with event
+ * mask oldMask (NULL if none) to one with newMask: turn on the monitors
+ * the new state waits for and schedule those no longer waited for to be
+ * turned off.
+ */
+static void automon_enter(SSCB *ss, const bitMask *oldMask, const bitMask *newMask)
+{
+	PROG	*sp = ss->prog;
+	unsigned nch;
+	double	now;
+
+	pvTimeGetCurrentDouble(&now);
+	for (nch = 0; nch < sp->numChans; nch++)
+	{
+		CHAN	*ch = sp->chan + nch;
+		boolean	was, is, turn_on = FALSE;
+
+		if (!ch->autoMon)
+			continue;
+		was = oldMask && waitsFor(oldMask, ch);
+		is = waitsFor(newMask, ch);
+		if (was == is)
+			continue;
+
+		epicsMutexMustLock(sp->lock);
+		if (is)
+		{
+			ch->autoMonOff = 0;
+			turn_on = ch->autoMonUsers++ == 0 && wantMonitor(ch)
+				&& ch->dbch && ch->dbch->connected;
+		}
+		else if (--ch->autoMonUsers == 0)
+		{
+			ch->autoMonOff = now + sp->monGrace;
+			if (!ss->autoMonNext || ch->autoMonOff < ss->autoMonNext)
+				ss->autoMonNext = ch->autoMonOff;
+		}
+		epicsMutexUnlock(sp->lock);
+
+		/* Must not hold the program lock here, see seq_share.c */
+		if (turn_on)
+			seq_camonitor(ch, TRUE);
+	}
+}
+
+/*
+ * automon_expire() - Turn off the automatic monitors whose grace
+ * period has expired and find out when the next one expires.
+ */
+static void automon_expire(SSCB *ss, double now)
+{
+	PROG	*sp = ss->prog;
+	unsigned nch;
+	double	next = 0;
+
+	for (nch = 0; nch < sp->numChans; nch++)
+	{
+		CHAN	*ch = sp->chan + nch;
+		boolean	turn_off = FALSE;
+
+		if (!ch->autoMon)
+			continue;
+
+		epicsMutexMustLock(sp->lock);
+		if (ch->autoMonOff && ch->autoMonOff <= now)
+		{
+			ch->autoMonOff = 0;
+			turn_off = ch->dbch != NULL;
+		}
+		else if (ch->autoMonOff && (!next || ch->autoMonOff < next))
+		{
+			next = ch->autoMonOff;
+		}
+		epicsMutexUnlock(sp->lock);
+
+		if (turn_off)
+		{
+			seq_camonitor(ch, FALSE);
+			/* another state set may have wanted it meanwhile */
+			epicsMutexMustLock(sp->lock);
+			turn_off = !wantMonitor(ch);
+			epicsMutexUnlock(sp->lock);
+			if (!turn_off)
+				seq_camonitor(ch, TRUE);
+		}
+	}
+	ss->autoMonNext = next;
+}
+
 /*
  * ss_wakeup() -- wake up each state set that is waiting on this event
  * based on the current event mask; eventNum = 0 means wake all state sets.
@@ -410,6 +954,10 @@ void ss_wakeup(PROG *sp, unsigned eventNum)
 	{
 		SSCB *ss = sp->ss + nss;
 
+		/* Skip state sets that never wait for this event */
+		if (eventNum && !bitTest(ss->waitMask, eventNum))
+			continue;
+
 		epicsMutexMustLock(sp->lock);
 		/* If event bit in mask is set, wake that state set */
 		DEBUG("ss_wakeup: eventNum=%d, mask=%u, state set=%d\n", eventNum, 
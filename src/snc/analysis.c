@@ -33,14 +33,15 @@ void *structdefs = &structdefs;
 static void analyse_definitions(Program *p);
 static void analyse_option(Options *options, Node *defn);
 static void analyse_state_option(StateOptions *options, Node *defn);
+static void check_options(Program *p);
 static void analyse_declaration(SymTable st, Node *scope, Node *defn);
 static void analyse_assign(SymTable st, ChanList *chan_list, Node *scope, Node *defn);
 static void analyse_monitor(SymTable st, Node *scope, Node *defn);
 static void analyse_sync(SymTable st, Node *scope, Node *defn);
 static void analyse_syncq(SymTable st, SyncQList *syncq_list, Node *scope, Node *defn);
-static void assign_subscript(ChanList *chan_list, Node *defn, Var *vp, Node *subscr, Node *pv_name);
-static void assign_single(ChanList *chan_list, Node *defn, Var *vp, Node *pv_name);
-static void assign_multi(ChanList *chan_list, Node *defn, Var *vp, Node *pv_name_list);
+static void assign_subscript(ChanList *chan_list, Node *defn, Var *vp, Node *subscr, Node *pv_name, int prio);
+static void assign_single(ChanList *chan_list, Node *defn, Var *vp, Node *pv_name, int prio);
+static void assign_multi(ChanList *chan_list, Node *defn, Var *vp, Node *pv_name_list, int prio);
 static Chan *new_channel(ChanList *chan_list, Var *vp, uint count, uint index);
 static SyncQ *new_sync_queue(SyncQList *syncq_list, uint size);
 static void connect_variables(SymTable st, Node *scope);
@@ -83,6 +84,7 @@ Program *analyse_program(Node *prog, Options options)
 #endif
 
 	analyse_definitions(p);
+	check_options(p);
 	p->num_ss = connect_states(p->sym_table, prog);
 	connect_variables(p->sym_table, prog);
 	connect_state_change_stmts(p->sym_table, prog);
@@ -292,9 +294,15 @@ static void analyse_option(Options *options, Node *defn)
 		switch(*optname)
 		{
 		case 'a': options->async = optval; break;
+		case 'b': options->combine = optval; break;
+		case 'z': options->lazy = optval; break;
+		case 'u': options->automon = optval; break;
+		case 'k': options->blocks = optval; break;
+		case 'p': options->profile = optval; break;
 		case 'c': options->conn = optval; break;
 		case 'd': options->debug = optval; break;
 		case 'e': options->newef = optval; break;
+		case 'g': options->cacheget = optval; break;
 		case 'l': options->line = optval; break;
 		case 'm': options->main = optval; break;
 		case 'r': options->reent = optval; break;
@@ -310,6 +318,21 @@ static void analyse_option(Options *options, Node *defn)
 	}
 }
 
+/* Warn about options that have no effect with the other options in force */
+static void check_options(Program *p)
+{
+	if (p->options.cacheget && !p->options.safe)
+	{
+		warning_at_node(p->prog,
+			"option +g has no effect without +s\n");
+	}
+	if (p->options.blocks && !p->options.safe)
+	{
+		warning_at_node(p->prog,
+			"option +k has no effect without +s\n");
+	}
+}
+
 /* Options in state declarations. Note: latest given value for option wins. */
 static void analyse_state_option(StateOptions *options, Node *defn)
 {
@@ -492,6 +515,7 @@ static void analyse_assign(SymTable st, ChanList *chan_list, Node *scope, Node *
 {
 	char *name;
 	Var *vp;
+	int prio = -1;
 
 	assert(chan_list);		/* precondition */
 	assert(scope);			/* precondition */
@@ -523,21 +547,34 @@ static void analyse_assign(SymTable st, ChanList *chan_list, Node *scope, Node *
 	{
 		warning_at_node(defn, "state local assign is deprecated\n");
 	}
+	/* CA priorities range from 0 to 99 */
+	if (defn->assign_prio)
+	{
+		uint val;
+
+		if (!strtoui(defn->assign_prio->token.str, 100, &val))
+		{
+			error_at_node(defn->assign_prio, "priority '%s' out of range\n",
+				defn->assign_prio->token.str);
+			return;
+		}
+		prio = (int)val;
+	}
 	if (defn->assign_subscr)
 	{
-		assign_subscript(chan_list, defn, vp, defn->assign_subscr, defn->assign_pvs);
+		assign_subscript(chan_list, defn, vp, defn->assign_subscr, defn->assign_pvs, prio);
 	}
 	else if (!defn->assign_pvs)
 	{
-		assign_single(chan_list, defn, vp, 0);
+		assign_single(chan_list, defn, vp, 0, prio);
 	}
 	else if (defn->assign_pvs->tag == E_INIT)
 	{
-		assign_multi(chan_list, defn, vp, defn->assign_pvs->init_elems);
+		assign_multi(chan_list, defn, vp, defn->assign_pvs->init_elems, prio);
 	}
 	else
 	{
-		assign_single(chan_list, defn, vp, defn->assign_pvs);
+		assign_single(chan_list, defn, vp, defn->assign_pvs, prio);
 	}
 }
 
@@ -548,7 +585,8 @@ static void assign_single(
 	ChanList	*chan_list,
 	Node		*defn,
 	Var		*vp,
-	Node		*pv_name
+	Node		*pv_name,
+	int		prio
 )
 {
 	char *name = pv_name ? pv_name->token.str : "";
@@ -570,6 +608,7 @@ static void assign_single(
 	vp->chan.single = new_channel(
 		chan_list, vp, type_array_length1(vp->type) * type_array_length2(vp->type), 0);
 	vp->chan.single->name = name;
+	vp->chan.single->priority = prio;
 }
 
 static void assign_elem(
@@ -577,7 +616,8 @@ static void assign_elem(
 	Node		*defn,
 	Var		*vp,
 	uint		n_subscr,
-	char		*pv_name
+	char		*pv_name,
+	int		prio
 )
 {
 	assert(chan_list);				/* precondition */
@@ -606,6 +646,7 @@ static void assign_elem(
 		return;
 	}
 	vp->chan.multi[n_subscr]->name = pv_name;
+	vp->chan.multi[n_subscr]->priority = prio;
 }
 
 /* Assign an array element to a channel.
@@ -615,7 +656,8 @@ static void assign_subscript(
 	Node		*defn,
 	Var		*vp,
 	Node		*subscr,
-	Node		*pv_name
+	Node		*pv_name,
+	int		prio
 )
 {
 	uint n_subscr;
@@ -647,7 +689,7 @@ static void assign_subscript(
 			vp->name, subscr->token.str);
 		return;
 	}
-	assign_elem(chan_list, defn, vp, n_subscr, pv_name->token.str);
+	assign_elem(chan_list, defn, vp, n_subscr, pv_name->token.str, prio);
 }
 
 /* Assign an array variable to multiple channels.
@@ -657,7 +699,8 @@ static void assign_multi(
 	ChanList	*chan_list,
 	Node		*defn,
 	Var		*vp,
-	Node		*pv_name_list
+	Node		*pv_name_list,
+	int		prio
 )
 {
 	Node	*pv_name;
@@ -692,12 +735,12 @@ static void assign_multi(
 				"in multiple assign to variable '%s'\n", vp->name);
 			break;
 		}
-		assign_elem(chan_list, defn, vp, n_subscr++, pv_name->token.str);
+		assign_elem(chan_list, defn, vp, n_subscr++, pv_name->token.str, prio);
 	}
 	/* for the remaining array elements, assign to "" */
 	while (n_subscr < type_array_length1(vp->type))
 	{
-		assign_elem(chan_list, defn, vp, n_subscr++, "");
+		assign_elem(chan_list, defn, vp, n_subscr++, "", prio);
 	}
 }
 
@@ -1169,6 +1212,7 @@ static Chan *new_channel(ChanList *chan_list, Var *vp, uint count, uint index)
 	cp->var = vp;
 	cp->count = count;
 	cp->index = index;
+	cp->priority = -1;
 	if (index == 0)
 		vp->index = chan_list->num_elems;
 	chan_list->num_elems++;
@@ -12,6 +12,7 @@ static struct const_symbol const_symbols[] =
     {"FALSE",               CT_OTHER },
     {"SYNC",                CT_OTHER },
     {"ASYNC",               CT_OTHER },
+    {"CACHED",              CT_OTHER },
     {"NOEVFLAG",            CT_EVFLAG},
     {"pvStatOK",            CT_OTHER },
     {"pvStatERROR",         CT_OTHER },
@@ -69,6 +70,7 @@ static const struct param *pvParams[]                    = {&pvP,0};
 static const struct param *pvArrayParams[]               = {&pvArrayP,&lengthP,0};
 static const struct param *pvSyncParams[]                = {&pvP,&efP,0};
 static const struct param *pvArraySyncParams[]           = {&pvArrayP,&lengthP,&efP,0};
+static const struct param *pvArrayAssignParams[]         = {&pvArrayP,&lengthP,&noDefP,0};
 static const struct param *pvGetPutParams[]              = {&pvP,&compTypeP,&tmoP,0};
 static const struct param *pvArrayGetPutCompleteParams[] = {&pvArrayP,&lengthP,&boolP,&ptrP,0};
 /* for backward compatibility */
@@ -76,50 +78,52 @@ static const struct param *pvPutCompleteParams[]         = {&pvP,&defLenP,&boolP
 
 static struct func_symbol func_symbols[] =
 {
-    /* name              c_name     action_only cond_only params                    */
-    {"delay",               0,          FALSE,  TRUE,   otherParams                 },
-    {"efClear",             0,          TRUE,   FALSE,  efParams                    },
-    {"efSet",               0,          TRUE,   FALSE,  efParams                    },
-    {"efTest",              0,          FALSE,  FALSE,  efParams                    },
-    {"efTestAndClear",      0,          FALSE,  FALSE,  efParams                    },
-    {"macValueGet",         0,          FALSE,  FALSE,  otherParams                 },
-    {"optGet",              0,          FALSE,  FALSE,  otherParams                 },
-    {"pvAssign",            0,          FALSE,  FALSE,  assignParams                },
-    {"pvAssignCount",       0,          FALSE,  FALSE,  noParams                    },
-    {"pvAssignSubst",       0,          FALSE,  FALSE,  assignParams                },
-    {"pvAssigned",          0,          FALSE,  FALSE,  pvParams                    },
-    {"pvChannelCount",      0,          FALSE,  FALSE,  noParams                    },
-    {"pvConnectCount",      0,          FALSE,  FALSE,  noParams                    },
-    {"pvConnected",         0,          FALSE,  FALSE,  pvParams                    },
-    {"pvArrayConnected",    0,          FALSE,  FALSE,  pvArrayParams               },
-    {"pvCount",             0,          FALSE,  FALSE,  pvParams                    },
-    {"pvFlush",             0,          FALSE,  FALSE,  noParams                    },
-    {"pvFlushQ",            0,          FALSE,  FALSE,  pvParams                    },
-    {"pvFreeQ",             0,          FALSE,  FALSE,  pvParams                    },
-    {"pvGet",               "pvGetTmo", FALSE,  FALSE,  pvGetPutParams              },
-    {"pvGetCancel",         0,          FALSE,  FALSE,  pvParams                    },
-    {"pvArrayGetCancel",    0,          FALSE,  FALSE,  pvArrayParams               },
-    {"pvGetComplete",       0,          FALSE,  FALSE,  pvParams                    },
-    {"pvArrayGetComplete",  0,          FALSE,  FALSE,  pvArrayGetPutCompleteParams },
-    {"pvGetQ",              0,          FALSE,  FALSE,  pvParams                    },
-    {"pvIndex",             0,          FALSE,  FALSE,  pvParams                    },
-    {"pvMessage",           0,          FALSE,  FALSE,  pvParams                    },
-    {"pvMonitor",           0,          FALSE,  FALSE,  pvParams                    },
-    {"pvArrayMonitor",      0,          FALSE,  FALSE,  pvArrayParams               },
-    {"pvName",              0,          FALSE,  FALSE,  pvParams                    },
-    {"pvPut",               "pvPutTmo", FALSE,  FALSE,  pvGetPutParams              },
-    {"pvPutCancel",         0,          FALSE,  FALSE,  pvParams                    },
-    {"pvArrayPutCancel",    0,          FALSE,  FALSE,  pvArrayParams               },
-    {"pvPutComplete",       0,          FALSE,  FALSE,  pvPutCompleteParams         },
-    {"pvArrayPutComplete",  0,          FALSE,  FALSE,  pvArrayGetPutCompleteParams },
-    {"pvSeverity",          0,          FALSE,  FALSE,  pvParams                    },
-    {"pvStatus",            0,          FALSE,  FALSE,  pvParams                    },
-    {"pvStopMonitor",       0,          FALSE,  FALSE,  pvParams                    },
-    {"pvArrayStopMonitor",  0,          FALSE,  FALSE,  pvArrayParams               },
-    {"pvSync",              0,          FALSE,  FALSE,  pvSyncParams                },
-    {"pvArraySync",         0,          FALSE,  FALSE,  pvArraySyncParams           },
-    {"pvTimeStamp",         0,          FALSE,  FALSE,  pvParams                    },
-    {0,                     0,          FALSE,  FALSE,  0                           }
+    /* name              c_name      action_only cond_only reads_var by_mode shared_type params   */
+    {"delay",               0,          FALSE,  TRUE,   FALSE,  FALSE,  "seqBool",  otherParams                 },
+    {"efClear",             0,          TRUE,   FALSE,  FALSE,  FALSE,  0,          efParams                    },
+    {"efSet",               0,          TRUE,   FALSE,  FALSE,  FALSE,  0,          efParams                    },
+    {"efTest",              0,          FALSE,  FALSE,  FALSE,  TRUE,   0,          efParams                    },
+    {"efTestAndClear",      0,          FALSE,  FALSE,  FALSE,  TRUE,   0,          efParams                    },
+    {"macValueGet",         0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          otherParams                 },
+    {"optGet",              0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          otherParams                 },
+    {"pvAssign",            0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          assignParams                },
+    {"pvArrayAssign",       0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvArrayAssignParams         },
+    {"pvAssignCount",       0,          FALSE,  FALSE,  FALSE,  FALSE,  "unsigned", noParams                    },
+    {"pvAssignSubst",       0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          assignParams                },
+    {"pvAssigned",          0,          FALSE,  FALSE,  FALSE,  FALSE,  "seqBool",  pvParams                    },
+    {"pvChannelCount",      0,          FALSE,  FALSE,  FALSE,  FALSE,  "unsigned", noParams                    },
+    {"pvConnectCount",      0,          FALSE,  FALSE,  FALSE,  FALSE,  "unsigned", noParams                    },
+    {"pvConnected",         0,          FALSE,  FALSE,  FALSE,  TRUE,   "seqBool",  pvParams                    },
+    {"pvArrayConnected",    0,          FALSE,  FALSE,  FALSE,  TRUE,   "seqBool",  pvArrayParams               },
+    {"pvCount",             0,          FALSE,  FALSE,  FALSE,  FALSE,  "unsigned", pvParams                    },
+    {"pvFlush",             0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          noParams                    },
+    {"pvFlushQ",            0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvParams                    },
+    {"pvFreeQ",             0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvParams                    },
+    {"pvGet",               "pvGetTmo", FALSE,  FALSE,  FALSE,  TRUE,   0,          pvGetPutParams              },
+    {"pvGetCancel",         0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvParams                    },
+    {"pvArrayGetCancel",    0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvArrayParams               },
+    {"pvGetComplete",       0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvParams                    },
+    {"pvArrayGetComplete",  0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvArrayGetPutCompleteParams },
+    {"pvGetQ",              0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvParams                    },
+    {"pvIndex",             0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvParams                    },
+    {"pvMessage",           0,          FALSE,  FALSE,  TRUE,   FALSE,  0,          pvParams                    },
+    {"pvMonitor",           0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvParams                    },
+    {"pvArrayMonitor",      0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvArrayParams               },
+    {"pvName",              0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvParams                    },
+    {"pvPut",               "pvPutTmo", FALSE,  FALSE,  TRUE,   TRUE,   0,          pvGetPutParams              },
+    {"pvPutCancel",         0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvParams                    },
+    {"pvArrayPutCancel",    0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvArrayParams               },
+    {"pvPutComplete",       0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvPutCompleteParams         },
+    {"pvArrayPutComplete",  0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvArrayGetPutCompleteParams },
+    {"pvPutPending",        0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvParams                    },
+    {"pvSeverity",          0,          FALSE,  FALSE,  TRUE,   FALSE,  0,          pvParams                    },
+    {"pvStatus",            0,          FALSE,  FALSE,  TRUE,   FALSE,  0,          pvParams                    },
+    {"pvStopMonitor",       0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvParams                    },
+    {"pvArrayStopMonitor",  0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvArrayParams               },
+    {"pvSync",              0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvSyncParams                },
+    {"pvArraySync",         0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          pvArraySyncParams           },
+    {"pvTimeStamp",         0,          FALSE,  FALSE,  TRUE,   FALSE,  0,          pvParams                    },
+    {0,                     0,          FALSE,  FALSE,  FALSE,  FALSE,  0,          0                           },
 };
 
 /* Insert builtin constants into symbol table */
@@ -36,6 +36,12 @@ struct func_symbol {
     const char *c_name;         /* C name, or 0 if same as SNL name */
     uint action_only:1;         /* not allowed in when-conditions */
     uint cond_only:1;           /* only allowed in when-conditions */
+    uint reads_var:1;           /* uses value or meta data of pv argument */
+    uint by_mode:1;             /* run-time has variants for safe and
+                                   traditional mode (suffix Safe/Trad) */
+    const char *shared_type;    /* C result type if calls with the same
+                                   constant arguments can share one result
+                                   within the guards of a state, else 0 */
     const struct param **params;/* parameter descriptions */
 };
 
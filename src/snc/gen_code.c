@@ -28,7 +28,7 @@ static void gen_main(char *prog_name);
 static void gen_var_struct(Node *prog, uint opt_reent);
 static void gen_init_reg(char *prog_name);
 static void gen_func_decls(Node *prog);
-static void gen_global_defn(Node *defn);
+static void gen_global_defn(Node *defn, Options options);
 
 static int assert_var_declared(Node *ep, Node *scope, void *parg)
 {
@@ -70,7 +70,7 @@ void generate_code(Program *p)
 	/* Initial definitions *except* global variable declarations,
 	   in the order in which they appear in the program.
 	   Note: this includes escaped C code. */
-	foreach (defn, p->prog->prog_defns) gen_global_defn(defn);
+	foreach (defn, p->prog->prog_defns) gen_global_defn(defn, p->options);
 
 	/* Variable declarations */
 	gen_var_struct(p->prog, p->options.reent);
@@ -85,7 +85,7 @@ void generate_code(Program *p)
 	gen_tables(p);
 
 	/* Extra definitions */
-	foreach (defn, p->prog->prog_xdefns) gen_global_defn(defn);
+	foreach (defn, p->prog->prog_xdefns) gen_global_defn(defn, p->options);
 
 	/* Main function */
 	if (p->options.main) gen_main(p->name);
@@ -247,7 +247,7 @@ void gen_defn_c_code(Node *scope, int level)
 	}
 }
 
-static void gen_global_defn(Node *ep)
+static void gen_global_defn(Node *ep, Options options)
 {
 	Node *member;
 	Var *vp;
@@ -259,7 +259,7 @@ static void gen_global_defn(Node *ep)
 		gen_code("%s\n", ep->token.str);
 		break;
 	case D_FUNCDEF:
-		gen_funcdef(ep);
+		gen_funcdef(ep, options);
 		break;
 	case D_STRUCTDEF:
 		gen_code("\nstruct %s {\n", ep->token.str);
@@ -25,6 +25,11 @@ void indent(int level);
 #define NM_CHANS	"seqg_chans"
 #define NM_STATES	"seqg_states"
 #define NM_STATESETS	"seqg_statesets"
+#define NM_SSCHANS	"seqg_sschans"
+#define NM_SSREADS	"seqg_ssreads"
+#define NM_SSPUTS	"seqg_ssputs"
+#define NM_PROFILE	"seqg_profile"
+#define NM_PROFTAB	"seqg_proftab"
 
 /* names and name prefixes for generated functions */
 #define NM_ENTRY	"seqg_entry"
@@ -41,6 +46,13 @@ void indent(int level);
 #define NM_PTRN		"seqg_ptrn"
 #define NM_PNST		"seqg_pnst"
 
+/* name of generated local variable for profiling */
+#define NM_PTIME	"seqg_ptime"
+
+/* prefixes for generated local variables holding shared call results */
+#define NM_SHARED	"seqg_shared"
+#define NM_HAVE		"seqg_have"
+
 /* prefix for generated inititialization variable names */
 #define NM_INITVAR	"seqg_initvar_"
 
@@ -42,6 +42,7 @@ static void gen_event_body(Node *xp, int context);
 static void gen_action_body(Node *xp, int context);
 static void gen_expr(int context, Node *ep, int level);
 static void gen_builtin_call(int context, Node *ep);
+static void gen_shared_call(int context, Node *ep);
 static void gen_ef_arg(
 	int		context,
 	const char	*func_name,	/* function name */
@@ -67,6 +68,7 @@ static void gen_prog_entex_func(
 	void (*gen_body)(Node *)
 );
 static void gen_prog_init_body(Node *prog);
+static void gen_profile_table(Node *prog);
 static void gen_prog_entry_body(Node *prog);
 static void gen_prog_exit_body(Node *prog);
 
@@ -92,6 +94,14 @@ enum context
  */
 static Options global_options;
 
+/*
+ * With option +p, the number of the profile entry for the block
+ * currently being generated. Blocks are numbered in the order in
+ * which gen_ss_code generates them; gen_profile_table must follow
+ * the same order.
+ */
+static int profile_num;
+
 /* Generate state set C code from analysed syntax tree */
 void gen_ss_code(Node *prog, Options options)
 {
@@ -103,6 +113,10 @@ void gen_ss_code(Node *prog, Options options)
 
 	gen_code("\n#define " NM_VAR " (*(struct " NM_VARS " *const *)" NM_ENV ")\n");
 
+	/* Generate profile table */
+	if (options.profile)
+		gen_profile_table(prog);
+
 	/* Generate program init func */
 	gen_prog_func(prog, "init", NM_INIT, gen_prog_init_body);
 
@@ -130,7 +144,7 @@ void gen_ss_code(Node *prog, Options options)
 					C_SS, "Exit", NM_EXIT, "void", "");
 			/* Generate event processing function */
 			gen_state_func(ssp->token.str, ss_num, sp->token.str,
-				sp->state_whens, gen_event_body,
+				sp, gen_event_body,
 				C_SS, "Event", NM_EVENT, "seqBool",
 				", int *"NM_PTRN", int *"NM_PNST);
 			/* Generate action processing function */
@@ -214,10 +228,35 @@ static void gen_block(Node *xp, int context, int level)
 	indent(level); gen_code("}\n");
 }
 
+/* Generate a statement that charges the time since the last
+   profile stamp to the current block */
+static void gen_profile_lap(int level)
+{
+	indent(level);
+	gen_code("seq_profileLap(" NM_PROFILE " + %d, &" NM_PTIME ");\n",
+		profile_num);
+}
+
+static void gen_profile_start(int level)
+{
+	indent(level);
+	gen_code("double " NM_PTIME " = seq_profileStart();\n");
+}
+
 static void gen_entex_body(Node *xp, int context)
 {
 	assert(xp->tag == D_ENTEX);
-	gen_block(xp->entex_block, context, 0);
+	if (global_options.profile)
+	{
+		gen_code("{\n");
+		gen_profile_start(1);
+		indent(1); gen_block(xp->entex_block, context, 1);
+		gen_profile_lap(1);
+		gen_code("}\n");
+		profile_num++;
+	}
+	else
+		gen_block(xp->entex_block, context, 0);
 }
 
 /* Generate action processing functions:
@@ -230,6 +269,8 @@ static void gen_action_body(Node *xp, int context)
 	const int	level = 1;
 
 	gen_code("{\n");
+	if (global_options.profile)
+		gen_profile_start(level);
 	/* "switch" statment based on the transition number */
 	indent(level); gen_code("switch(" NM_TRN ")\n");
 	indent(level); gen_code("{\n");
@@ -243,6 +284,11 @@ static void gen_action_body(Node *xp, int context)
 		indent(level); gen_code("case %d:\n", trans_num);
 		indent(level+1); gen_block(tp->when_block, context, level+1);
 		/* end of case */
+		if (global_options.profile)
+		{
+			gen_profile_lap(level+1);
+			profile_num++;
+		}
 		indent(level+1); gen_code("return;\n");
 		trans_num++;
 	}
@@ -253,16 +299,30 @@ static void gen_action_body(Node *xp, int context)
 }
 
 /* Generate a C function that checks events for a particular state */
-static void gen_event_body(Node *xp, int context)
+static void gen_event_body(Node *sp, int context)
 {
+	State		*st = sp->extra.e_state;
 	Node		*tp;
 	int		trans_num;
+	uint		n;
 	const int	level = 1;
 
+	assert(sp->tag == D_STATE);
 	gen_code("{\n");
+	/* results of calls shared between conditions, see guard_cse.c */
+	for (n = 0; n < st->num_shared; n++)
+	{
+		indent(level);
+		gen_code("%s " NM_SHARED "%u = 0;\n",
+			st->shared[n]->func_expr->extra.e_builtin->shared_type, n);
+		indent(level);
+		gen_code("seqBool " NM_HAVE "%u = FALSE;\n", n);
+	}
+	if (global_options.profile)
+		gen_profile_start(level);
 	trans_num = 0;
 	/* For each transition generate an "if" statement ... */
-	foreach (tp, xp)
+	foreach (tp, sp->state_whens)
 	{
 		Node *next_sp;
 
@@ -276,6 +336,8 @@ static void gen_event_body(Node *xp, int context)
 			gen_expr(C_COND, tp->when_cond, 0);
 		gen_code(")\n");
 		indent(level); gen_code("{\n");
+		if (global_options.profile)
+			gen_profile_lap(level+1);
 
 		next_sp = tp->extra.e_when->next_state;
 		if (!next_sp)
@@ -292,6 +354,11 @@ static void gen_event_body(Node *xp, int context)
 		indent(level+1);gen_code("*" NM_PTRN " = %d;\n", trans_num);
 		indent(level+1); gen_code("return TRUE;\n");
 		indent(level); gen_code("}\n");
+		if (global_options.profile)
+		{
+			gen_profile_lap(level);
+			profile_num++;
+		}
 		trans_num++;
 	}
 	indent(level); gen_code("return FALSE;\n");
@@ -417,7 +484,11 @@ static void gen_expr(
 			break;
 		}
 		indent(level);
-		gen_code("{*" NM_PNST " = %d; return;}\n", ep->extra.e_change->extra.e_state->index);
+		gen_code("{*" NM_PNST " = %d; ", ep->extra.e_change->extra.e_state->index);
+		if (global_options.profile)
+			gen_code("seq_profileLap(" NM_PROFILE " + %d, &" NM_PTIME "); ",
+				profile_num);
+		gen_code("return;}\n");
 		break;
 	case S_RETURN:
 		if (context != C_FUNC)
@@ -450,7 +521,10 @@ static void gen_expr(
 	case E_FUNC:
 		if (ep->func_expr->tag == E_BUILTIN)
 		{
-			gen_builtin_call(context, ep);
+			if (ep->extra.e_shared)
+				gen_shared_call(context, ep);
+			else
+				gen_builtin_call(context, ep);
 			break;
 		}
 		gen_expr(context, ep->func_expr, 0);
@@ -547,7 +621,10 @@ static void gen_builtin_call(int context, Node *ep)
 	/* All builtin functions require ssId as 1st parameter */
 	assert_at_node(context != C_GLOBAL, ep,
 		"calling built-in function %s not allowed here\n", fsym->name);
-	gen_code("seq_%s("NM_ENV, fsym->c_name ? fsym->c_name : fsym->name);
+	/* call the variant for the mode if there is one, saving the
+	   run-time test */
+	gen_code("seq_%s%s("NM_ENV, fsym->c_name ? fsym->c_name : fsym->name,
+		!fsym->by_mode ? "" : global_options.safe ? "Safe" : "Trad");
 	if (fsym->cond_only && context != C_COND)
 	{
 		error_at_node(ep,
@@ -609,6 +686,20 @@ static void gen_builtin_call(int context, Node *ep)
 	gen_code(")");
 }
 
+/* Generate a call whose result is shared with equal calls in the
+   other conditions of the state: only the first one evaluated calls
+   the function */
+static void gen_shared_call(int context, Node *ep)
+{
+	uint n = ep->extra.e_shared - 1;
+
+	assert(context == C_COND);
+	gen_code("(" NM_HAVE "%u ? " NM_SHARED "%u : (" NM_HAVE "%u = TRUE, "
+		NM_SHARED "%u = ", n, n, n, n);
+	gen_builtin_call(context, ep);
+	gen_code("))");
+}
+
 /* Check an event flag argument */
 static void gen_ef_arg(
 	int		context,
@@ -810,9 +901,66 @@ static void gen_prog_entex_func(
 static void gen_prog_init_body(Node *prog)
 {
 	assert(prog->tag == D_PROG);
+	if (global_options.profile)
+	{
+		indent(1); gen_code("seq_profileRegister(&" NM_PROFTAB ");\n");
+	}
 	gen_user_var_init(prog, 1);
 }
 
+static void gen_profile_entry(const char *ss_name, const char *state_name,
+	const char *kind, int line)
+{
+	if (ss_name)
+		gen_code("\t{\"%s\", \"%s\", \"%s\", %d, 0, 0.0},\n",
+			ss_name, state_name, kind, line);
+	else
+		gen_code("\t{0, 0, \"%s\", %d, 0, 0.0},\n", kind, line);
+	profile_num++;
+}
+
+/* Generate the profile table, with one entry for each entry and exit
+   block, when condition, and action */
+static void gen_profile_table(Node *prog)
+{
+	Node	*ssp, *sp, *tp;
+
+	assert(prog->tag == D_PROG);
+	gen_code("\n/* Profile table */\n");
+	gen_code("static seqProfileEntry " NM_PROFILE "[] = {\n");
+	profile_num = 0;
+	if (prog->prog_entry)
+		gen_profile_entry(0, 0, "entry", prog->prog_entry->token.line);
+	foreach (ssp, prog->prog_statesets)
+	{
+		const char *ss_name = ssp->token.str;
+
+		foreach (sp, ssp->ss_states)
+		{
+			const char *state_name = sp->token.str;
+
+			if (sp->state_entry)
+				gen_profile_entry(ss_name, state_name, "entry",
+					sp->state_entry->token.line);
+			if (sp->state_exit)
+				gen_profile_entry(ss_name, state_name, "exit",
+					sp->state_exit->token.line);
+			foreach (tp, sp->state_whens)
+				gen_profile_entry(ss_name, state_name, "when",
+					tp->token.line);
+			foreach (tp, sp->state_whens)
+				gen_profile_entry(ss_name, state_name, "action",
+					tp->when_block->token.line);
+		}
+	}
+	if (prog->prog_exit)
+		gen_profile_entry(0, 0, "exit", prog->prog_exit->token.line);
+	gen_code("};\n");
+	gen_code("static seqProfile " NM_PROFTAB " = {\"%s\", " NM_PROFILE ", %d, 0};\n",
+		prog->token.str, profile_num);
+	profile_num = 0;
+}
+
 static void gen_prog_entry_body(Node *prog)
 {
 	assert(prog->tag == D_PROG);
@@ -825,8 +973,10 @@ static void gen_prog_exit_body(Node *prog)
 	gen_entex_body(prog->prog_exit, C_SS);
 }
 
-void gen_funcdef(Node *fp)
+void gen_funcdef(Node *fp, Options options)
 {
+	/* functions defined before the state sets are generated first */
+	global_options = options;
 	if (fp->tag == D_FUNCDEF)
 	{
 		Var *vp = fp->funcdef_decl->extra.e_decl;
@@ -16,6 +16,6 @@ in the file LICENSE that is included with this distribution.
 #include "types.h"
 
 void gen_ss_code(Node *prog, Options options);
-void gen_funcdef(Node *fp);
+void gen_funcdef(Node *fp, Options options);
 
 #endif	/*INCLgensscodeh*/
@@ -22,6 +22,8 @@ in the file LICENSE that is included with this distribution.
 #include "node.h"
 #include "var_types.h"
 #include "gen_tables.h"
+#include "builtin.h"
+#include "snl.h"
 #include "seq_mask.h"
 #include "seq_release.h"
 
@@ -30,6 +32,16 @@ typedef struct event_mask_args {
 	uint	num_event_flags;
 } event_mask_args;
 
+typedef struct ss_chans_args {
+	char	*used;		/* one flag for each channel */
+	char	*read;		/* whether the channel's value is read */
+	char	*put;		/* whether the channel is passed to pvPut */
+	Node	**funcdefs;	/* SNL function definitions */
+	char	*visited;	/* one flag for each function definition */
+	uint	num_funcdefs;
+	int	all;		/* whether any channel might be used */
+} ss_chans_args;
+
 static void gen_channel_table(ChanList *chan_list, uint num_event_flags, int opt_reent);
 static void gen_channel(Chan *cp, uint num_event_flags, int opt_reent);
 static void gen_state_table(Node *ss_list, uint num_event_flags, uint num_channels);
@@ -37,7 +49,13 @@ static void fill_state_struct(Node *sp, char *ss_name, uint ss_num);
 static void gen_prog_table(Program *p);
 static void encode_options(Options options);
 static void encode_state_options(StateOptions options);
-static void gen_ss_table(Node *ss_list);
+static void gen_ss_table(Program *p);
+static int gen_ss_chans(Program *p, Node *ssp, ss_chans_args *args);
+static void find_ss_chans(Node *ep, ss_chans_args *args);
+static void gen_ss_chan_mask(const char *name, Node *ssp, const char *flags,
+	uint num_chans);
+static void mark_ss_chans(Var *vp, int read, int put, ss_chans_args *args);
+static int iter_ss_chans(Node *ep, Node *scope, void *parg);
 static void gen_state_event_mask(Node *sp, uint num_event_flags,
 	seqMask *event_words, uint num_event_words);
 static int iter_event_mask_scalar(Node *ep, Node *scope, void *parg);
@@ -49,7 +67,7 @@ void gen_tables(Program *p)
 	gen_code("\n/************************ Tables ************************/\n");
 	gen_channel_table(p->chan_list, p->num_event_flags, p->options.reent);
 	gen_state_table(p->prog->prog_statesets, p->num_event_flags, p->chan_list->num_elems);
-	gen_ss_table(p->prog->prog_statesets);
+	gen_ss_table(p);
 	gen_prog_table(p);
 }
 
@@ -62,7 +80,7 @@ static void gen_channel_table(ChanList *chan_list, uint num_event_flags, int opt
 	{
 		gen_code("\n/* Channel table */\n");
 		gen_code("static seqChan " NM_CHANS "[] = {\n");
-		gen_code("\t/* chName, offset, varName, varType, count, eventNum, efId, monitored, queueSize, queueIndex */\n");
+		gen_code("\t/* chName, offset, varName, varType, count, eventNum, efId, monitored, queueSize, queueIndex, priority */\n");
 		foreach (cp, chan_list->first)
 		{
 			gen_channel(cp, num_event_flags, opt_reent);
@@ -173,6 +191,8 @@ static void gen_channel(Chan *cp, uint num_event_flags, int opt_reent)
 		gen_code("DEFAULT_QUEUE_SIZE, %d", cp->syncq->index);
 	else
 		gen_code("%d, %d", cp->syncq->size, cp->syncq->index);
+	/* CA priority */
+	gen_code(", %d", cp->priority);
 	gen_code("}");
 }
 
@@ -252,29 +272,293 @@ static void encode_state_options(StateOptions options)
 	gen_code(")");
 } 
 
+/* Identifiers that global C code needs in order to use channel ids: the
+   run time functions that take them, the state set id they also take,
+   and the types of both. Any mention of one of these (even as part of a
+   longer identifier) counts. */
+static const char *const chan_id_idents[] =
+{
+	"seq_pv",
+	"SS_ID",
+	"CH_ID",
+	"ssId",
+	"state_set",
+	NM_ENV,
+	0
+};
+
+/* Whether global C code might use channel ids */
+static int mentions_chan_ids(const char *text)
+{
+	const char *const *ip;
+
+	for (ip = chan_id_idents; *ip; ip++)
+	{
+		if (strstr(text, *ip))
+			return TRUE;
+	}
+	return FALSE;
+}
+
 /* Generate state set table, one entry for each state set */
-static void gen_ss_table(Node *ss_list)
+static void gen_ss_table(Program *p)
 {
-	Node	*ssp;
+	Node	*ssp, *defn, *defns[2];
 	int	num_ss;
+	uint	n, num_chans = p->chan_list->num_elems;
+	int	*num_used = newArray(int, p->num_ss);
+	int	global_c = FALSE;
+	ss_chans_args args;
+
+	/* Collect function definitions, which are searched on demand, and
+	   look for global C code that might use channel ids */
+	args.used = newArray(char, num_chans + 1);
+	args.read = newArray(char, num_chans + 1);
+	args.put = newArray(char, num_chans + 1);
+	args.num_funcdefs = 0;
+	defns[0] = p->prog->prog_defns;
+	defns[1] = p->prog->prog_xdefns;
+	for (n = 0; n < 2; n++)
+		foreach (defn, defns[n])
+			if (defn->tag == D_FUNCDEF)
+				args.num_funcdefs++;
+	args.funcdefs = newArray(Node *, args.num_funcdefs + 1);
+	args.visited = newArray(char, args.num_funcdefs + 1);
+	args.num_funcdefs = 0;
+	for (n = 0; n < 2; n++)
+	{
+		foreach (defn, defns[n])
+		{
+			if (defn->tag == D_FUNCDEF)
+				args.funcdefs[args.num_funcdefs++] = defn;
+			else if (defn->tag == T_TEXT && mentions_chan_ids(defn->token.str))
+				global_c = TRUE;
+		}
+	}
+
+	num_ss = 0;
+	foreach (ssp, p->prog->prog_statesets)
+	{
+		args.all = global_c;
+		num_used[num_ss] = gen_ss_chans(p, ssp, &args);
+		num_ss++;
+	}
 
 	gen_code("\n/* State set table */\n");
 	gen_code("static seqSS " NM_STATESETS "[] = {\n");
 	num_ss = 0;
-	foreach (ssp, ss_list)
+	foreach (ssp, p->prog->prog_statesets)
 	{
+		int	known = num_used[num_ss] >= 0;
+
 		if (num_ss > 0)
 			gen_code("\n");
-		num_ss++;
 		gen_code("\t{\n");
 		gen_code("\t/* state set name */    \"%s\",\n", ssp->token.str);
 		gen_code("\t/* states */            " NM_STATES "_%s,\n", ssp->token.str);
-		gen_code("\t/* number of states */  %d\n", ssp->extra.e_ss->num_states);
+		gen_code("\t/* number of states */  %d,\n", ssp->extra.e_ss->num_states);
+		if (known)
+			gen_code("\t/* channels used */     " NM_SSCHANS "_%s,\n", ssp->token.str);
+		else
+			gen_code("\t/* channels used */     0,\n");
+		gen_code("\t/* num. channels */     %d,\n", known ? num_used[num_ss] : 0);
+		if (known)
+		{
+			gen_code("\t/* channels read */     " NM_SSREADS "_%s,\n", ssp->token.str);
+			gen_code("\t/* channels put */      " NM_SSPUTS "_%s\n", ssp->token.str);
+		}
+		else
+		{
+			gen_code("\t/* channels read */     0,\n");
+			gen_code("\t/* channels put */      0\n");
+		}
 		gen_code("\t},\n");
+		num_ss++;
+	}
+	gen_code("};\n");
+	free(num_used);
+	free(args.used);
+	free(args.read);
+	free(args.put);
+	free(args.funcdefs);
+	free(args.visited);
+}
+
+/* Generate the sorted list of channels a state set uses, so that the
+   runtime allocates request slots only for these, and the mask of
+   channels whose value or meta data it reads, so that in safe mode
+   only these get refreshed, and the mask of channels it passes to
+   pvPut, so that queues with a single writer need no lock. References
+   from the program's entry and exit blocks count for the first state
+   set (which runs them), those from functions for each state set that
+   calls them. If escaped C code or a C function that is passed the
+   state set id might compute channel ids, don't generate tables and
+   return -1 (every channel gets a slot and is read). Otherwise return
+   the length of the list. */
+static int gen_ss_chans(Program *p, Node *ssp, ss_chans_args *args)
+{
+	uint	nch, num_chans = p->chan_list->num_elems;
+	int	num_used = 0;
+
+	memset(args->used, 0, num_chans);
+	memset(args->read, 0, num_chans);
+	memset(args->put, 0, num_chans);
+	memset(args->visited, 0, args->num_funcdefs);
+
+	find_ss_chans(ssp, args);
+	if (ssp == p->prog->prog_statesets)
+	{
+		if (p->prog->prog_entry)
+			find_ss_chans(p->prog->prog_entry, args);
+		if (p->prog->prog_exit)
+			find_ss_chans(p->prog->prog_exit, args);
+	}
+	if (args->all)
+		return -1;
+
+	gen_code("\n/* Channels used by state set \"%s\" */\n", ssp->token.str);
+	gen_code("static const unsigned " NM_SSCHANS "_%s[] = {", ssp->token.str);
+	for (nch = 0; nch < num_chans; nch++)
+	{
+		if (!args->used[nch])
+			continue;
+		gen_code("%s%u,", num_used % 10 ? " " : "\n\t", nch);
+		num_used++;
+	}
+	/* C does not allow empty arrays */
+	gen_code(num_used ? "\n};\n" : " 0 };\n");
+
+	gen_ss_chan_mask(NM_SSREADS, ssp, args->read, num_chans);
+	gen_ss_chan_mask(NM_SSPUTS, ssp, args->put, num_chans);
+	return num_used;
+}
+
+/* Generate a mask with a bit set for each channel whose flag is set. */
+static void gen_ss_chan_mask(const char *name, Node *ssp, const char *flags,
+	uint num_chans)
+{
+	uint	nch, n;
+
+	gen_code("static const seqMask %s_%s[] = {\n", name, ssp->token.str);
+	for (n = 0; n < NWORDS(num_chans); n++)
+	{
+		seqMask	word = 0;
+
+		for (nch = n * NBITS; nch < num_chans && nch < (n + 1) * NBITS; nch++)
+			if (flags[nch])
+				word |= 1u << (nch % NBITS);
+		gen_code("\t0x%08x,\n", word);
 	}
 	gen_code("};\n");
 }
 
+/* Find the channels used and read in the syntax tree ep. */
+static void find_ss_chans(Node *ep, ss_chans_args *args)
+{
+	traverse_syntax_tree(ep, bit(E_VAR)|bit(E_CONST)|bit(E_BINOP)|bit(E_FUNC)|bit(T_TEXT),
+		0, 0, iter_ss_chans, args);
+}
+
+/* Mark the channels of an assigned variable as used and possibly
+   read or put. */
+static void mark_ss_chans(Var *vp, int read, int put, ss_chans_args *args)
+{
+	uint	nch, num_chans;
+
+	if (vp->assign == M_NONE)
+		return;
+	/* a subscript might select any element of an array */
+	num_chans = vp->assign == M_MULTI ? type_array_length1(vp->type) : 1;
+	for (nch = vp->index; nch < vp->index + num_chans; nch++)
+	{
+		args->used[nch] = TRUE;
+		if (read)
+			args->read[nch] = TRUE;
+		if (put)
+			args->put[nch] = TRUE;
+	}
+}
+
+/* Iteratee for channels used by a state set. */
+static int iter_ss_chans(Node *ep, Node *scope, void *parg)
+{
+	ss_chans_args	*args = (ss_chans_args *)parg;
+	Node		*ap;
+	Var		*vp;
+	uint		n;
+
+	switch (ep->tag)
+	{
+	case T_TEXT:
+		args->all = TRUE;
+		return FALSE;
+	case E_CONST:
+		if (strcmp(ep->token.str, NM_ENV) == 0)
+			args->all = TRUE;
+		return FALSE;
+	case E_BINOP:
+		/* assigning to a scalar variable does not read it */
+		ap = ep->binop_left;
+		if (ep->token.symbol != TOK_EQUAL || ap->tag != E_VAR
+			|| !ap->extra.e_var || ap->extra.e_var->type->tag != T_PRIM)
+			return TRUE;
+		mark_ss_chans(ap->extra.e_var, FALSE, FALSE, args);
+		find_ss_chans(ep->binop_right, args);
+		return FALSE;
+	case E_FUNC:
+		/* most built-in functions don't look at the variable
+		   (pvGet and friends refresh it themselves) */
+		if (ep->func_expr->tag != E_BUILTIN || !ep->func_args)
+			return TRUE;
+		ap = ep->func_args;
+		if (ap->tag == E_SUBSCR && ap->subscr_operand->tag == E_VAR)
+			vp = ap->subscr_operand->extra.e_var;
+		else if (ap->tag == E_VAR)
+			vp = ap->extra.e_var;
+		else
+			return TRUE;
+		if (vp && strcmp(ep->func_expr->extra.e_builtin->name, "pvPut") == 0)
+			mark_ss_chans(vp, FALSE, TRUE, args);
+		if (ep->func_expr->extra.e_builtin->reads_var)
+			return TRUE;
+		if (ap->tag == E_SUBSCR)
+			find_ss_chans(ap->subscr_index, args);
+		if (vp)
+			mark_ss_chans(vp, FALSE, FALSE, args);
+		foreach (ap, ap->next)
+			find_ss_chans(ap, args);
+		return FALSE;
+	case E_VAR:
+		if (strcmp(ep->token.str, "ssId") == 0 || strcmp(ep->token.str, NM_ENV) == 0)
+		{
+			args->all = TRUE;
+			return FALSE;
+		}
+		vp = ep->extra.e_var;
+		if (!vp)
+			return FALSE;
+		if (vp->type->tag != T_FUNCTION)
+		{
+			mark_ss_chans(vp, TRUE, FALSE, args);
+			return FALSE;
+		}
+		/* descend into SNL functions the first time they are referenced */
+		for (n = 0; n < args->num_funcdefs; n++)
+		{
+			Node *defn = args->funcdefs[n];
+
+			if (defn->funcdef_decl->extra.e_decl == vp && !args->visited[n])
+			{
+				args->visited[n] = TRUE;
+				find_ss_chans(defn->funcdef_block, args);
+			}
+		}
+		return FALSE;
+	default:
+		return TRUE;
+	}
+}
+
 /* Generate a single program structure ("seqProgram") */
 static void gen_prog_table(Program *p)
 {
@@ -311,6 +595,18 @@ static void encode_options(Options options)
 		gen_code(" | OPT_DEBUG");
 	if (options.newef)
 		gen_code(" | OPT_NEWEF");
+	if (options.cacheget)
+		gen_code(" | OPT_CACHEGET");
+	if (options.combine)
+		gen_code(" | OPT_COMBINE");
+	if (options.lazy)
+		gen_code(" | OPT_LAZY");
+	if (options.automon)
+		gen_code(" | OPT_AUTOMON");
+	if (options.blocks)
+		gen_code(" | OPT_BLOCKS");
+	if (options.profile)
+		gen_code(" | OPT_PROFILE");
 	if (options.reent)
 		gen_code(" | OPT_REENT");
 	if (options.safe)
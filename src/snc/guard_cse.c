@@ -0,0 +1,248 @@
+/*************************************************************************\
+Copyright (c) 2010-2015 Helmholtz-Zentrum Berlin f. Materialien
+                        und Energie GmbH, Germany (HZB)
+This file is distributed subject to a Software License Agreement found
+in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+/*************************************************************************\
+                Shared calls in when conditions
+\*************************************************************************/
+/*
+ * The when conditions of a state are evaluated in order, each time the
+ * state set wakes up. Calls to built-in functions that have a
+ * shared_type (see builtin.c) and appear more than once in these
+ * conditions with the same constant arguments can share one result per
+ * pass. The code generator evaluates a shared call where it first
+ * happens to be evaluated and re-uses the result at the other places, so
+ * that neither the order of evaluation nor the priority of transitions
+ * changes.
+ *
+ * States whose conditions call a function that could change a shared
+ * result, i.e. an SNL or C function or one of the pvAssign family, are
+ * left alone.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "types.h"
+#include "analysis.h"
+#include "builtin.h"
+#include "guard_cse.h"
+
+struct guard_calls
+{
+	Node	**calls;	/* shareable calls, 0 while counting */
+	uint	num_calls;	/* number of shareable calls */
+	uint	barrier;	/* conditions call an unsafe function */
+};
+
+static const char *const barriers[] =
+{
+	"pvAssign",
+	"pvAssignSubst",
+	"pvArrayAssign",
+	0
+};
+
+static int is_assign_op(const char *op)
+{
+	size_t len = strlen(op);
+
+	return len > 0 && op[len-1] == '=' && strcmp(op, "==") != 0
+		&& strcmp(op, "!=") != 0 && strcmp(op, "<=") != 0
+		&& strcmp(op, ">=") != 0;
+}
+
+/* Whether an expression is made of constants only */
+static int is_const_expr(Node *ep)
+{
+	const char *op = ep->token.str;
+
+	switch (ep->tag)
+	{
+	case E_CONST:
+	case E_STRING:
+		return TRUE;
+	case E_PAREN:
+		return is_const_expr(ep->paren_expr);
+	case E_PRE:
+		return (strcmp(op, "-") == 0 || strcmp(op, "+") == 0
+			|| strcmp(op, "!") == 0 || strcmp(op, "~") == 0)
+			&& is_const_expr(ep->pre_operand);
+	case E_BINOP:
+		return !is_assign_op(op) && is_const_expr(ep->binop_left)
+			&& is_const_expr(ep->binop_right);
+	default:
+		return FALSE;
+	}
+}
+
+/* Whether a pv argument denotes the same channel on every call */
+static int is_const_pv_arg(Node *ap)
+{
+	return ap->tag == E_VAR || (ap->tag == E_SUBSCR
+		&& ap->subscr_operand->tag == E_VAR
+		&& is_const_expr(ap->subscr_index));
+}
+
+/* Whether a call can share its result with equal calls */
+static int is_shareable(Node *ep)
+{
+	struct func_symbol *fsym = ep->func_expr->extra.e_builtin;
+	const struct param **ppp;
+	Node *ap = ep->func_args;
+
+	if (!fsym->shared_type)
+		return FALSE;
+	for (ppp = fsym->params; *ppp && ap; ppp++, ap = ap->next)
+	{
+		switch ((*ppp)->type)
+		{
+		case PT_PV:
+		case PT_PV_ARRAY:
+			if (!is_const_pv_arg(ap))
+				return FALSE;
+			break;
+		case PT_OTHER:
+			if (!is_const_expr(ap))
+				return FALSE;
+			break;
+		default:
+			return FALSE;
+		}
+	}
+	return ap == 0;
+}
+
+static int same_expr(Node *a, Node *b);
+
+static int same_expr_list(Node *a, Node *b)
+{
+	for (; a && b; a = a->next, b = b->next)
+	{
+		if (!same_expr(a, b))
+			return FALSE;
+	}
+	return a == b;
+}
+
+static int same_expr(Node *a, Node *b)
+{
+	uint i;
+
+	if (a->tag != b->tag)
+		return FALSE;
+	switch (a->tag)
+	{
+	case E_VAR:
+		return a->extra.e_var == b->extra.e_var;
+	case E_BUILTIN:
+		return a->extra.e_builtin == b->extra.e_builtin;
+	default:
+		if ((a->token.str == 0) != (b->token.str == 0)
+			|| (a->token.str && strcmp(a->token.str, b->token.str) != 0))
+			return FALSE;
+	}
+	for (i = 0; i < node_info[a->tag].num_children; i++)
+	{
+		if (!same_expr_list(a->children[i], b->children[i]))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static int collect_call(Node *ep, Node *scope, void *parg)
+{
+	struct guard_calls *gc = (struct guard_calls *)parg;
+	Node *fp = ep->func_expr;
+	const char *const *bp;
+
+	assert(ep->tag == E_FUNC);
+	if (fp->tag != E_BUILTIN)
+	{
+		/* sizeof does not evaluate its argument */
+		if (fp->tag != E_VAR || strcmp(fp->token.str, "sizeof") != 0)
+			gc->barrier = TRUE;
+		return FALSE;
+	}
+	for (bp = barriers; *bp; bp++)
+	{
+		if (strcmp(fp->extra.e_builtin->name, *bp) == 0)
+			gc->barrier = TRUE;
+	}
+	if (is_shareable(ep))
+	{
+		if (gc->calls)
+			gc->calls[gc->num_calls] = ep;
+		gc->num_calls++;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void collect_calls(Node *sp, struct guard_calls *gc)
+{
+	Node *tp;
+
+	gc->num_calls = 0;
+	foreach (tp, sp->state_whens)
+	{
+		if (tp->when_cond)
+			traverse_syntax_tree(tp->when_cond, bit(E_FUNC), 0, 0,
+				collect_call, gc);
+	}
+}
+
+/* Find the calls in the when conditions of a state that can share
+   their result, and number them */
+static void share_state_calls(Node *sp)
+{
+	State			*st = sp->extra.e_state;
+	struct guard_calls	gc = {0, 0, FALSE};
+	uint			i, j;
+
+	assert(sp->tag == D_STATE);
+	collect_calls(sp, &gc);
+	if (gc.barrier || gc.num_calls < 2)
+		return;
+	gc.calls = newArray(Node *, gc.num_calls);
+	collect_calls(sp, &gc);
+
+	st->shared = newArray(Node *, gc.num_calls);
+	for (i = 0; i < gc.num_calls; i++)
+	{
+		Node *ep = gc.calls[i];
+
+		if (ep->extra.e_shared)
+			continue;
+		for (j = i + 1; j < gc.num_calls; j++)
+		{
+			Node *cep = gc.calls[j];
+
+			if (cep->extra.e_shared || !same_expr(ep, cep))
+				continue;
+			if (!ep->extra.e_shared)
+			{
+				st->shared[st->num_shared++] = ep;
+				ep->extra.e_shared = st->num_shared;
+			}
+			cep->extra.e_shared = ep->extra.e_shared;
+		}
+	}
+	free(gc.calls);
+}
+
+void share_guard_calls(Node *prog)
+{
+	Node *ssp, *sp;
+
+	assert(prog->tag == D_PROG);
+	foreach (ssp, prog->prog_statesets)
+	{
+		foreach (sp, ssp->ss_states)
+		{
+			share_state_calls(sp);
+		}
+	}
+}
@@ -0,0 +1,17 @@
+/*************************************************************************\
+Copyright (c) 2010-2015 Helmholtz-Zentrum Berlin f. Materialien
+                        und Energie GmbH, Germany (HZB)
+This file is distributed subject to a Software License Agreement found
+in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+/*************************************************************************\
+                Shared calls in when conditions
+\*************************************************************************/
+#ifndef INCLguardcseh
+#define INCLguardcseh
+
+#include "types.h"
+
+void share_guard_calls(Node *prog);
+
+#endif	/*INCLguardcseh*/
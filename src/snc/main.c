@@ -19,6 +19,7 @@ in the file LICENSE that is included with this distribution.
 #include "parser.h"
 #include "analysis.h"
 #include "gen_code.h"
+#include "guard_cse.h"
 #include "main.h"
 
 #include "seq_release.h"
@@ -70,7 +71,10 @@ int main(int argc, char *argv[])
         prg = analyse_program(exp, options);
 
 	if (err_cnt == 0)
+	{
+		share_guard_calls(prg->prog);
 		generate_code(prg);
+	}
 
 	return err_cnt ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -155,6 +159,9 @@ static void parse_option(char *s)
 	case 'a':
 		options.async = opt_val;
 		break;
+	case 'b':
+		options.combine = opt_val;
+		break;
 	case 'c':
 		options.conn = opt_val;
 		break;
@@ -164,6 +171,18 @@ static void parse_option(char *s)
 	case 'e':
 		options.newef = opt_val;
 		break;
+	case 'g':
+		options.cacheget = opt_val;
+		break;
+	case 'u':
+		options.automon = opt_val;
+		break;
+	case 'k':
+		options.blocks = opt_val;
+		break;
+	case 'p':
+		options.profile = opt_val;
+		break;
 	case 'r':
 		options.reent = opt_val;
 		break;
@@ -176,6 +195,9 @@ static void parse_option(char *s)
 	case 's':
 		options.safe = opt_val;
 		break;
+	case 'z':
+		options.lazy = opt_val;
+		break;
 	case 'w':
 		options.warn = opt_val;
 		break;
@@ -195,16 +217,22 @@ static void print_usage(void)
 	report("options:\n");
 	report("  -o <outfile> - override name of output file\n");
 	report("  +a           - do asynchronous pvGet\n");
+	report("  +b           - combine fire-and-forget pvPuts within an action\n");
 	report("  -c           - don't wait for all connects\n");
 	report("  +d           - turn on debug run-time option\n");
 	report("  -e           - don't use new event flag mode\n");
+	report("  +g           - synchronous pvGet uses monitored value if available\n");
 	report("  -l           - suppress line numbering\n");
 	report("  +m           - generate main program\n");
 	report("  -i           - don't register commands/programs\n");
+	report("  +k           - safe mode refreshes only changed blocks of arrays\n");
+	report("  +p           - profile when conditions, actions, entry and exit blocks\n");
 	report("  +r           - make reentrant at run-time\n");
 	report("  +s           - safe mode (implies +r, overrides -r)\n");
+	report("  +u           - monitor only while a state waits for the channel\n");
 	report("  -w           - suppress compiler warnings\n");
 	report("  +W           - enable extra compiler warnings\n");
+	report("  +z           - connect channels on first use\n");
 	report("example:\n snc +a -c vacuum.st\n");
 }
 
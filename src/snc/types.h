@@ -65,6 +65,12 @@ struct options
 	uint	reent:1;		/* reentrant */
 	uint	safe:1;			/* safe (no globals) */
 	uint	newef:1;		/* new event flag mode */
+	uint	cacheget:1;		/* sync pvGet from monitor cache */
+	uint	combine:1;		/* combine fire&forget pvPuts per action */
+	uint	lazy:1;			/* connect channels on first use */
+	uint	automon:1;		/* monitor only while a state waits */
+	uint	blocks:1;		/* refresh only changed blocks */
+	uint	profile:1;		/* profile generated code */
 
 					/* compile time options */
 	uint	main:1;			/* generate main program */
@@ -73,7 +79,7 @@ struct options
 	uint	xwarn:1;		/* extra compiler warnings */
 };
 
-#define DEFAULT_OPTIONS {0,1,0,0,0,1,0,1,1,0}
+#define DEFAULT_OPTIONS {0,1,0,0,0,1,0,0,0,0,0,0,0,1,1,0}
 
 struct state_options			/* run-time state options */
 {
@@ -103,6 +109,8 @@ struct state				/* extra data for state clauses */
 	uint		is_target;	/* is this state a target state? */
 	StateOptions	options;	/* state options */
 	VarList		*var_list;	/* list of 'local' variables */
+	Node		**shared;	/* calls shared between when conditions */
+	uint		num_shared;	/* number of shared calls */
 };
 
 struct state_set			/* extra data for state set clauses */
@@ -114,7 +122,7 @@ struct state_set			/* extra data for state set clauses */
 /* Expression types */
 enum node_tag			/* description [child nodes...] */
 {
-	D_ASSIGN,		/* assign statement [subscr,pvs] */
+	D_ASSIGN,		/* assign statement [subscr,pvs,prio] */
 	D_DECL,			/* variable declaration [init] */
 	D_ENTEX,		/* entry or exit statement [block] */
 	D_FUNCDEF,		/* function definition [decl,block] */
@@ -182,6 +190,7 @@ struct syntax_node			/* generic syntax node */
 		FuncSym	*e_builtin;	/* builtin function */
 		ConstSym *e_const;	/* builtin constant */
 		VarList *e_funcdef;	/* parameters */
+		uint	e_shared;	/* 1 + number of shared call, or 0 */
 	}	extra;
 };
 
@@ -228,6 +237,7 @@ struct channel				/* channel assignment info */
 	uint	index;			/* index (offset) if array element */
 	Var	*var;			/* variable definition */
 	uint	count;			/* request count for pv access */
+	int	priority;		/* CA priority (-1=default) */
 	uint	monitor:1;		/* whether this channel is monitored */
 	Var	*sync;			/* event flag variable if sync'd */
 	SyncQ	*syncq;			/* sync queue if syncQ'd */
@@ -320,6 +330,7 @@ enum multiplicity
    uniformly iterate over all children... */
 #define assign_subscr	children[0]
 #define assign_pvs	children[1]
+#define assign_prio	children[2]
 #define binop_left	children[0]
 #define binop_right	children[1]
 #define cast_type	children[0]
@@ -389,7 +400,7 @@ struct node_info
 node_info[]
 #ifdef node_info_GLOBAL
 = {
-	{ "D_ASSIGN",	2 },
+	{ "D_ASSIGN",	3 },
 	{ "D_DECL",	1 },
 	{ "D_ENTEX",	1 },
 	{ "D_FUNCDEF",	2 },
@@ -5,6 +5,8 @@ use strict;
 use Test::More;
 
 my $tests = {
+  blocks_no_safe          => { warnings => 1, errors => 0  },
+  cacheget_no_safe        => { warnings => 1, errors => 0  },
   cast                    => { warnings => 0, errors => 0  },
   change                  => { warnings => 0, errors => 2  },
   delay_in_action         => { warnings => 0, errors => 1  },
@@ -22,7 +24,9 @@ my $tests = {
   nesting_depth           => { warnings => 0, errors => 0  },
   pvArray                 => { warnings => 0, errors => 21 },
   pvNotAssigned           => { warnings => 0, errors => 20 },
+  priority_invalid        => { warnings => 0, errors => 2  },
   reservedId              => { warnings => 0, errors => 2  },
+  sharedGuards            => { warnings => 0, errors => 0, shared => 2 },
   state_not_reachable     => { warnings => 3, errors => 0  },
   sync_not_assigned       => { warnings => 0, errors => 1  },
   syncq_no_size           => { warnings => 1, errors => 0  },
@@ -33,7 +37,10 @@ my $tests = {
 
 my @progs = sort(keys(%$tests));
 
-plan tests => 4 * (@progs + 0);
+# number of shared calls in when conditions, see guard_cse.c
+my @shared = grep { defined $tests->{$_}->{shared} } @progs;
+
+plan tests => 4 * (@progs + 0) + @shared;
 
 sub snc_diag {
   diag "snc said this:";
@@ -55,9 +62,10 @@ foreach my $prog (@progs) {
   # test whether it terminated normally
   my $exitsig = $? & 127;
   is ($exitsig, 0, "$prog: snc terminates normally") or $failed = 1;
+  my $nshared = $tests->{$prog}->{shared};
   SKIP: {
     # skip all other tests if snc crashed
-    skip "snc died with signal $exitsig", 3 if $exitsig;
+    skip "snc died with signal $exitsig", 3 + (defined $nshared ? 1 : 0) if $exitsig;
     my $exitcode = $? >> 8;
     my $errors_are_expected = $tests->{$prog}->{errors} > 0;
     ok (($exitcode != 0) == $errors_are_expected, "$prog: correct exitcode");
@@ -67,6 +75,16 @@ foreach my $prog (@progs) {
     my $ne = 0;
     $ne++ while ($output =~ /error/g);
     is($ne, $tests->{$prog}->{errors}, "$prog: number of errors") or $failed = 1;
+    if (defined $nshared) {
+      my $ns = 0;
+      if (open(my $fh, "<", "$prog.c")) {
+        local $/;
+        my $code = <$fh>;
+        $ns++ while ($code =~ /seqBool seqg_have\d+ = FALSE;/g);
+        close($fh);
+      }
+      is($ns, $nshared, "$prog: number of shared calls") or $failed = 1;
+    }
   }
   snc_diag($output) if $failed;
 }
@@ -9,6 +9,7 @@ in the file LICENSE that is included with this distribution.
 #include "epicsThread.h"
 #include "epicsEvent.h"
 #include "epicsExit.h"
+#include "epicsTime.h"
 #include "seqCom.h"
 
 #include "../testSupport.h"
@@ -60,3 +61,11 @@ void seq_test_done(void)
     epicsAtThreadExit(seq_test_at_thread_exit, 0);
 #endif
 }
+
+/* Current time in seconds, for measuring durations */
+double seq_test_now(void)
+{
+    epicsTimeStamp ts;
+    epicsTimeGetCurrent(&ts);
+    return ts.secPastEpoch + 1e-9 * ts.nsec;
+}
@@ -14,5 +14,6 @@ in the file LICENSE that is included with this distribution.
 void run_seq_test(seqProgram *seqProg, const char *name, int adapt_priority);
 void seq_test_init(int num_tests);
 void seq_test_done(void);
+double seq_test_now(void);
 
 #endif /* INCtestSupport_h */